@@ -0,0 +1,20 @@
+#include "bench_input.h"
+#include "game_state.h"
+
+int scripted_input(long long frame, int ship)
+{
+	static const int routine[] =
+	{
+		INPUT_thrust | INPUT_fire,
+		INPUT_rotate_left | INPUT_fire,
+		INPUT_thrust | INPUT_rotate_right,
+		INPUT_fire,
+		INPUT_break | INPUT_rotate_left,
+		0,
+		INPUT_thrust | INPUT_rotate_right | INPUT_fire,
+		INPUT_break,
+	};
+
+	long long step = (frame + ship * 7) / 16;
+	return routine[step % (sizeof routine / sizeof routine[0])];
+}
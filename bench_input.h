@@ -0,0 +1,17 @@
+#ifndef _BENCH_INPUT_H_
+#define _BENCH_INPUT_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Inputs for a ship on a frame, the same for every benchmark. Each ship
+// sweeps through a fixed routine of turning, thrusting, braking and firing,
+// offset by its index so that the ships don't move in lockstep.
+int scripted_input(long long frame, int ship);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ifndef _BENCH_INPUT_H_
@@ -0,0 +1,313 @@
+#include "bullets.h"
+#include "cpu.h"
+
+#ifdef CPU_X86_64
+#include <emmintrin.h>
+#include <immintrin.h>
+#endif
+
+// Each kernel walks the store one active word at a time and skips groups of
+// lanes with no active bullet, which is most of them. Inactive lanes are left
+// untouched so that every kernel leaves the same bytes behind.
+
+static void integrate_scalar(Bullets *bullets, Bounds const *bounds)
+{
+	Scalar left = scalar_from_int(bounds->left);
+	Scalar top = scalar_from_int(bounds->top);
+	Scalar right = scalar_from_int(bounds->right);
+	Scalar bottom = scalar_from_int(bounds->bottom);
+
+	for (int w = 0; w < bullets->capacity / 32; w++)
+	{
+		unsigned int active = bullets->active[w];
+
+		for (int lane = 0; lane < 32 && (active >> lane); lane++)
+		{
+			if (!((active >> lane) & 1))
+			{
+				continue;
+			}
+
+			int i = w * 32 + lane;
+
+			bullets->x[i] += bullets->dx[i];
+			bullets->y[i] += bullets->dy[i];
+
+			if (bullets->x[i] < left ||
+				bullets->y[i] < top ||
+				bullets->x[i] > right ||
+				bullets->y[i] > bottom)
+			{
+				active &= ~(1u << lane);
+			}
+		}
+
+		bullets->active[w] = active;
+	}
+}
+
+#if defined(CPU_X86_64) && !defined(VECTORWAR_FIXED_POINT)
+
+static void integrate_sse2(Bullets *bullets, Bounds const *bounds)
+{
+	__m128d left = _mm_set1_pd(scalar_from_int(bounds->left));
+	__m128d top = _mm_set1_pd(scalar_from_int(bounds->top));
+	__m128d right = _mm_set1_pd(scalar_from_int(bounds->right));
+	__m128d bottom = _mm_set1_pd(scalar_from_int(bounds->bottom));
+
+	for (int w = 0; w < bullets->capacity / 32; w++)
+	{
+		unsigned int active = bullets->active[w];
+		unsigned int outside = 0;
+
+		for (int lane = 0; lane < 32 && (active >> lane); lane += 2)
+		{
+			unsigned int bits = (active >> lane) & 3;
+
+			if (!bits)
+			{
+				continue;
+			}
+
+			int i = w * 32 + lane;
+
+			__m128d mask = _mm_castsi128_pd(_mm_set_epi64x(
+				-(long long)(bits >> 1), -(long long)(bits & 1)));
+
+			__m128d x = _mm_loadu_pd(bullets->x + i);
+			__m128d y = _mm_loadu_pd(bullets->y + i);
+			__m128d nx = _mm_add_pd(x, _mm_loadu_pd(bullets->dx + i));
+			__m128d ny = _mm_add_pd(y, _mm_loadu_pd(bullets->dy + i));
+
+			x = _mm_or_pd(_mm_and_pd(mask, nx), _mm_andnot_pd(mask, x));
+			y = _mm_or_pd(_mm_and_pd(mask, ny), _mm_andnot_pd(mask, y));
+
+			_mm_storeu_pd(bullets->x + i, x);
+			_mm_storeu_pd(bullets->y + i, y);
+
+			__m128d out = _mm_or_pd(
+				_mm_or_pd(_mm_cmplt_pd(x, left), _mm_cmplt_pd(y, top)),
+				_mm_or_pd(_mm_cmpgt_pd(x, right), _mm_cmpgt_pd(y, bottom)));
+
+			outside |=
+				(unsigned int)_mm_movemask_pd(_mm_and_pd(out, mask)) << lane;
+		}
+
+		bullets->active[w] = active & ~outside;
+	}
+}
+
+CPU_TARGET_AVX2
+static void integrate_avx2(Bullets *bullets, Bounds const *bounds)
+{
+	__m256d left = _mm256_set1_pd(scalar_from_int(bounds->left));
+	__m256d top = _mm256_set1_pd(scalar_from_int(bounds->top));
+	__m256d right = _mm256_set1_pd(scalar_from_int(bounds->right));
+	__m256d bottom = _mm256_set1_pd(scalar_from_int(bounds->bottom));
+	__m256i lane_bits = _mm256_set_epi64x(8, 4, 2, 1);
+
+	for (int w = 0; w < bullets->capacity / 32; w++)
+	{
+		unsigned int active = bullets->active[w];
+		unsigned int outside = 0;
+
+		for (int lane = 0; lane < 32 && (active >> lane); lane += 4)
+		{
+			unsigned int bits = (active >> lane) & 15;
+
+			if (!bits)
+			{
+				continue;
+			}
+
+			int i = w * 32 + lane;
+
+			__m256d mask = _mm256_castsi256_pd(_mm256_cmpeq_epi64(
+				_mm256_and_si256(_mm256_set1_epi64x(bits), lane_bits),
+				lane_bits));
+
+			__m256d x = _mm256_loadu_pd(bullets->x + i);
+			__m256d y = _mm256_loadu_pd(bullets->y + i);
+			__m256d nx = _mm256_add_pd(x, _mm256_loadu_pd(bullets->dx + i));
+			__m256d ny = _mm256_add_pd(y, _mm256_loadu_pd(bullets->dy + i));
+
+			x = _mm256_blendv_pd(x, nx, mask);
+			y = _mm256_blendv_pd(y, ny, mask);
+
+			_mm256_storeu_pd(bullets->x + i, x);
+			_mm256_storeu_pd(bullets->y + i, y);
+
+			__m256d out = _mm256_or_pd(
+				_mm256_or_pd(
+					_mm256_cmp_pd(x, left, _CMP_LT_OQ),
+					_mm256_cmp_pd(y, top, _CMP_LT_OQ)),
+				_mm256_or_pd(
+					_mm256_cmp_pd(x, right, _CMP_GT_OQ),
+					_mm256_cmp_pd(y, bottom, _CMP_GT_OQ)));
+
+			outside |= (unsigned int)_mm256_movemask_pd(
+				_mm256_and_pd(out, mask)) << lane;
+		}
+
+		bullets->active[w] = active & ~outside;
+	}
+}
+
+#elif defined(CPU_X86_64)
+
+static void integrate_sse2(Bullets *bullets, Bounds const *bounds)
+{
+	__m128i left = _mm_set1_epi32(scalar_from_int(bounds->left));
+	__m128i top = _mm_set1_epi32(scalar_from_int(bounds->top));
+	__m128i right = _mm_set1_epi32(scalar_from_int(bounds->right));
+	__m128i bottom = _mm_set1_epi32(scalar_from_int(bounds->bottom));
+	__m128i lane_bits = _mm_set_epi32(8, 4, 2, 1);
+
+	for (int w = 0; w < bullets->capacity / 32; w++)
+	{
+		unsigned int active = bullets->active[w];
+		unsigned int outside = 0;
+
+		for (int lane = 0; lane < 32 && (active >> lane); lane += 4)
+		{
+			unsigned int bits = (active >> lane) & 15;
+
+			if (!bits)
+			{
+				continue;
+			}
+
+			int i = w * 32 + lane;
+
+			__m128i mask = _mm_cmpeq_epi32(
+				_mm_and_si128(_mm_set1_epi32((int)bits), lane_bits),
+				lane_bits);
+
+			__m128i x = _mm_loadu_si128((__m128i const*)(bullets->x + i));
+			__m128i y = _mm_loadu_si128((__m128i const*)(bullets->y + i));
+			__m128i nx = _mm_add_epi32(
+				x, _mm_loadu_si128((__m128i const*)(bullets->dx + i)));
+			__m128i ny = _mm_add_epi32(
+				y, _mm_loadu_si128((__m128i const*)(bullets->dy + i)));
+
+			x = _mm_or_si128(
+				_mm_and_si128(mask, nx), _mm_andnot_si128(mask, x));
+			y = _mm_or_si128(
+				_mm_and_si128(mask, ny), _mm_andnot_si128(mask, y));
+
+			_mm_storeu_si128((__m128i*)(bullets->x + i), x);
+			_mm_storeu_si128((__m128i*)(bullets->y + i), y);
+
+			__m128i out = _mm_or_si128(
+				_mm_or_si128(_mm_cmplt_epi32(x, left), _mm_cmplt_epi32(y, top)),
+				_mm_or_si128(
+					_mm_cmpgt_epi32(x, right), _mm_cmpgt_epi32(y, bottom)));
+
+			outside |= (unsigned int)_mm_movemask_ps(
+				_mm_castsi128_ps(_mm_and_si128(out, mask))) << lane;
+		}
+
+		bullets->active[w] = active & ~outside;
+	}
+}
+
+CPU_TARGET_AVX2
+static void integrate_avx2(Bullets *bullets, Bounds const *bounds)
+{
+	__m256i left = _mm256_set1_epi32(scalar_from_int(bounds->left));
+	__m256i top = _mm256_set1_epi32(scalar_from_int(bounds->top));
+	__m256i right = _mm256_set1_epi32(scalar_from_int(bounds->right));
+	__m256i bottom = _mm256_set1_epi32(scalar_from_int(bounds->bottom));
+	__m256i lane_bits = _mm256_set_epi32(128, 64, 32, 16, 8, 4, 2, 1);
+
+	for (int w = 0; w < bullets->capacity / 32; w++)
+	{
+		unsigned int active = bullets->active[w];
+		unsigned int outside = 0;
+
+		for (int lane = 0; lane < 32 && (active >> lane); lane += 8)
+		{
+			unsigned int bits = (active >> lane) & 255;
+
+			if (!bits)
+			{
+				continue;
+			}
+
+			int i = w * 32 + lane;
+
+			__m256i mask = _mm256_cmpeq_epi32(
+				_mm256_and_si256(_mm256_set1_epi32((int)bits), lane_bits),
+				lane_bits);
+
+			__m256i x = _mm256_loadu_si256((__m256i const*)(bullets->x + i));
+			__m256i y = _mm256_loadu_si256((__m256i const*)(bullets->y + i));
+			__m256i nx = _mm256_add_epi32(
+				x, _mm256_loadu_si256((__m256i const*)(bullets->dx + i)));
+			__m256i ny = _mm256_add_epi32(
+				y, _mm256_loadu_si256((__m256i const*)(bullets->dy + i)));
+
+			x = _mm256_blendv_epi8(x, nx, mask);
+			y = _mm256_blendv_epi8(y, ny, mask);
+
+			_mm256_storeu_si256((__m256i*)(bullets->x + i), x);
+			_mm256_storeu_si256((__m256i*)(bullets->y + i), y);
+
+			__m256i out = _mm256_or_si256(
+				_mm256_or_si256(
+					_mm256_cmpgt_epi32(left, x), _mm256_cmpgt_epi32(top, y)),
+				_mm256_or_si256(
+					_mm256_cmpgt_epi32(x, right),
+					_mm256_cmpgt_epi32(y, bottom)));
+
+			outside |= (unsigned int)_mm256_movemask_ps(
+				_mm256_castsi256_ps(_mm256_and_si256(out, mask))) << lane;
+		}
+
+		bullets->active[w] = active & ~outside;
+	}
+}
+
+#endif // if defined(CPU_X86_64) && !defined(VECTORWAR_FIXED_POINT)
+
+enum BULLET_KERNEL bullets_best_kernel(void)
+{
+#ifdef CPU_X86_64
+	static int has_avx2 = -1;
+
+	if (has_avx2 < 0)
+	{
+		has_avx2 = cpu_has_avx2();
+	}
+
+	return has_avx2 ? BULLET_KERNEL_avx2 : BULLET_KERNEL_sse2;
+#else
+	return BULLET_KERNEL_scalar;
+#endif
+}
+
+void bullets_integrate(
+	Bullets *bullets, Bounds const *bounds, enum BULLET_KERNEL kernel)
+{
+	if (kernel == BULLET_KERNEL_best || kernel > bullets_best_kernel())
+	{
+		kernel = bullets_best_kernel();
+	}
+
+	switch (kernel)
+	{
+#ifdef CPU_X86_64
+	case BULLET_KERNEL_sse2:
+		integrate_sse2(bullets, bounds);
+		break;
+
+	case BULLET_KERNEL_avx2:
+		integrate_avx2(bullets, bounds);
+		break;
+#endif
+
+	default:
+		integrate_scalar(bullets, bounds);
+		break;
+	}
+}
@@ -0,0 +1,34 @@
+#ifndef _BULLETS_H_
+#define _BULLETS_H_
+
+#include "game_state.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum BULLET_KERNEL
+{
+	BULLET_KERNEL_best = -1,
+	BULLET_KERNEL_scalar,
+	BULLET_KERNEL_sse2,
+	BULLET_KERNEL_avx2,
+};
+
+// The widest kernel this CPU can run.
+enum BULLET_KERNEL bullets_best_kernel(void);
+
+// Moves every active bullet by its velocity and deactivates those that end up
+// outside of bounds. Every kernel produces a bit-identical store, so the
+// scalar one can be used to check the others by game_state_hash. Kernels the
+// CPU can't run fall back to the best one it can.
+void bullets_integrate(
+	Bullets *bullets,
+	Bounds const *bounds,
+	enum BULLET_KERNEL kernel);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ifndef _BULLETS_H_
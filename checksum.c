@@ -0,0 +1,462 @@
+#include <string.h>
+#include "checksum.h"
+#include "cpu.h"
+
+#ifdef CPU_X86_64
+#include <emmintrin.h>
+#include <immintrin.h>
+#endif
+
+// See http://en.wikipedia.org/wiki/Fletcher%27s_checksum.
+static int fletcher32_scalar(short const *data, size_t len)
+{
+	int sum1 = 0xffff, sum2 = 0xffff;
+
+	while (len)
+	{
+		size_t tlen = len > FLETCHER32_BLOCK ? FLETCHER32_BLOCK : len;
+		len -= tlen;
+
+		do
+		{
+			sum1 += *data++;
+			sum2 += sum1;
+		} while (--tlen);
+
+		sum1 = (sum1 & 0xffff) + (sum1 >> 16);
+		sum2 = (sum2 & 0xffff) + (sum2 >> 16);
+	}
+
+	// Second reduction step to reduce sums to 16 bits.
+	sum1 = (sum1 & 0xffff) + (sum1 >> 16);
+	sum2 = (sum2 & 0xffff) + (sum2 >> 16);
+	return sum2 << 16 | sum1;
+}
+
+// Over a block of len words, the plain sum of the words and the sum of each
+// word weighted by how many times the scalar loop adds it into sum2, that is
+// len for the first word down to 1 for the last. Both wrap like the scalar
+// sums do, so the block's sums can be applied in one go and then reduced
+// exactly as the scalar loop reduces them.
+typedef void (*BlockSums)(
+	short const *data,
+	int len,
+	unsigned int *sum,
+	unsigned int *weighted);
+
+static void block_sums_tail(
+	short const *data,
+	int from,
+	int len,
+	unsigned int *sum,
+	unsigned int *weighted)
+{
+	for (int i = from; i < len; i++)
+	{
+		*sum += (unsigned int)data[i];
+		*weighted += (unsigned int)(len - i) * (unsigned int)data[i];
+	}
+}
+
+#ifdef CPU_X86_64
+
+static unsigned int horizontal_sum_sse2(__m128i v)
+{
+	v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+	v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+	return (unsigned int)_mm_cvtsi128_si32(v);
+}
+
+// Weights never exceed the block length, so pmaddwd can multiply and pair up
+// the words without overflowing.
+static void block_sums_sse2(
+	short const *data,
+	int len,
+	unsigned int *sum,
+	unsigned int *weighted)
+{
+	__m128i ones = _mm_set1_epi16(1);
+	__m128i step = _mm_set1_epi16(8);
+	__m128i weights = _mm_setr_epi16(
+		(short)len, (short)(len - 1), (short)(len - 2), (short)(len - 3),
+		(short)(len - 4), (short)(len - 5), (short)(len - 6), (short)(len - 7));
+
+	__m128i sums = _mm_setzero_si128();
+	__m128i weighted_sums = _mm_setzero_si128();
+	int i = 0;
+
+	for (; i + 8 <= len; i += 8)
+	{
+		__m128i words = _mm_loadu_si128((__m128i const*)(data + i));
+		sums = _mm_add_epi32(sums, _mm_madd_epi16(words, ones));
+		weighted_sums = _mm_add_epi32(
+			weighted_sums, _mm_madd_epi16(words, weights));
+		weights = _mm_sub_epi16(weights, step);
+	}
+
+	*sum = horizontal_sum_sse2(sums);
+	*weighted = horizontal_sum_sse2(weighted_sums);
+	block_sums_tail(data, i, len, sum, weighted);
+}
+
+CPU_TARGET_AVX2
+static void block_sums_avx2(
+	short const *data,
+	int len,
+	unsigned int *sum,
+	unsigned int *weighted)
+{
+	__m256i ones = _mm256_set1_epi16(1);
+	__m256i step = _mm256_set1_epi16(16);
+	__m256i weights = _mm256_setr_epi16(
+		(short)len, (short)(len - 1), (short)(len - 2), (short)(len - 3),
+		(short)(len - 4), (short)(len - 5), (short)(len - 6), (short)(len - 7),
+		(short)(len - 8), (short)(len - 9), (short)(len - 10), (short)(len - 11),
+		(short)(len - 12), (short)(len - 13), (short)(len - 14),
+		(short)(len - 15));
+
+	__m256i sums = _mm256_setzero_si256();
+	__m256i weighted_sums = _mm256_setzero_si256();
+	int i = 0;
+
+	for (; i + 16 <= len; i += 16)
+	{
+		__m256i words = _mm256_loadu_si256((__m256i const*)(data + i));
+		sums = _mm256_add_epi32(sums, _mm256_madd_epi16(words, ones));
+		weighted_sums = _mm256_add_epi32(
+			weighted_sums, _mm256_madd_epi16(words, weights));
+		weights = _mm256_sub_epi16(weights, step);
+	}
+
+	__m128i sums_128 = _mm_add_epi32(
+		_mm256_castsi256_si128(sums), _mm256_extracti128_si256(sums, 1));
+	__m128i weighted_128 = _mm_add_epi32(
+		_mm256_castsi256_si128(weighted_sums),
+		_mm256_extracti128_si256(weighted_sums, 1));
+
+	// A full block is 22 rows of 16 and one of 8.
+	if (i + 8 <= len)
+	{
+		__m128i words = _mm_loadu_si128((__m128i const*)(data + i));
+		__m128i row_weights = _mm256_castsi256_si128(weights);
+		sums_128 = _mm_add_epi32(
+			sums_128, _mm_madd_epi16(words, _mm_set1_epi16(1)));
+		weighted_128 = _mm_add_epi32(
+			weighted_128, _mm_madd_epi16(words, row_weights));
+		i += 8;
+	}
+
+	*sum = horizontal_sum_sse2(sums_128);
+	*weighted = horizontal_sum_sse2(weighted_128);
+	block_sums_tail(data, i, len, sum, weighted);
+}
+
+static int fletcher32_blocks(
+	short const *data, size_t len, BlockSums block_sums)
+{
+	int sum1 = 0xffff, sum2 = 0xffff;
+
+	while (len)
+	{
+		int tlen = len > FLETCHER32_BLOCK ? FLETCHER32_BLOCK : (int)len;
+		unsigned int sum, weighted;
+
+		block_sums(data, tlen, &sum, &weighted);
+		data += tlen;
+		len -= tlen;
+
+		sum2 = (int)((unsigned int)sum2 +
+			(unsigned int)tlen * (unsigned int)sum1 +
+			weighted);
+		sum1 = (int)((unsigned int)sum1 + sum);
+
+		sum1 = (sum1 & 0xffff) + (sum1 >> 16);
+		sum2 = (sum2 & 0xffff) + (sum2 >> 16);
+	}
+
+	sum1 = (sum1 & 0xffff) + (sum1 >> 16);
+	sum2 = (sum2 & 0xffff) + (sum2 >> 16);
+	return sum2 << 16 | sum1;
+}
+
+#endif
+
+enum CHECKSUM_KERNEL checksum_best_kernel(void)
+{
+#ifdef CPU_X86_64
+	static int has_avx2 = -1;
+
+	if (has_avx2 < 0)
+	{
+		has_avx2 = cpu_has_avx2();
+	}
+
+	return has_avx2 ? CHECKSUM_KERNEL_avx2 : CHECKSUM_KERNEL_sse2;
+#else
+	return CHECKSUM_KERNEL_scalar;
+#endif
+}
+
+int fletcher32_checksum_kernel(
+	short const *data, size_t len, enum CHECKSUM_KERNEL kernel)
+{
+	if (kernel == CHECKSUM_KERNEL_best || kernel > checksum_best_kernel())
+	{
+		kernel = checksum_best_kernel();
+	}
+
+	switch (kernel)
+	{
+#ifdef CPU_X86_64
+	case CHECKSUM_KERNEL_sse2:
+		return fletcher32_blocks(data, len, block_sums_sse2);
+
+	case CHECKSUM_KERNEL_avx2:
+		return fletcher32_blocks(data, len, block_sums_avx2);
+#endif
+
+	default:
+		return fletcher32_scalar(data, len);
+	}
+}
+
+void fletcher32_block_sums(
+	short const *data, int len, int *sum, int *weighted)
+{
+	unsigned int plain = 0, weighted_plain = 0;
+
+	switch (checksum_best_kernel())
+	{
+#ifdef CPU_X86_64
+	case CHECKSUM_KERNEL_sse2:
+		block_sums_sse2(data, len, &plain, &weighted_plain);
+		break;
+
+	case CHECKSUM_KERNEL_avx2:
+		block_sums_avx2(data, len, &plain, &weighted_plain);
+		break;
+#endif
+
+	default:
+		block_sums_tail(data, 0, len, &plain, &weighted_plain);
+		break;
+	}
+
+	*sum = (int)plain;
+	*weighted = (int)weighted_plain;
+}
+
+int fletcher32_checksum(short const *data, size_t len)
+{
+	return fletcher32_checksum_kernel(data, len, CHECKSUM_KERNEL_best);
+}
+
+// The stripe hash follows the accumulation of XXH3, see
+// https://github.com/Cyan4973/xxHash/blob/dev/doc/xxhash_spec.md: each 64 byte
+// stripe is mixed into eight 64 bit lanes with one 32x32 bit multiply a lane,
+// which vectorizes well. Anything short of a full stripe, and the lanes, are
+// then folded in with the rounds of XXH64.
+#define PRIME64_1 0x9E3779B185EBCA87ull
+#define PRIME64_2 0xC2B2AE3D27D4EB4Full
+#define PRIME64_3 0x165667B19E3779F9ull
+#define PRIME64_4 0x85EBCA77C2B2AE63ull
+#define PRIME64_5 0x27D4EB2F165667C5ull
+
+#define STRIPE_LANES 8
+#define STRIPE_SIZE  (STRIPE_LANES * 8)
+
+static const unsigned long long stripe_key[STRIPE_LANES] =
+{
+	0xbe4ba423396cfeb8ull, 0x1cad21f72c81017cull,
+	0xdb979083e96dd4deull, 0x1f67b3b7a4a44072ull,
+	0x78e5c0cc4ee679cbull, 0x2172ffcc7dd05a82ull,
+	0x8e2443f7744608b8ull, 0x4c263a81e69035e0ull,
+};
+
+typedef void (*Accumulate)(
+	unsigned long long *lanes,
+	unsigned char const *data,
+	size_t stripes);
+
+static unsigned long long rotate_left(unsigned long long x, int bits)
+{
+	return (x << bits) | (x >> (64 - bits));
+}
+
+static unsigned long long read64(unsigned char const *p)
+{
+	unsigned long long x;
+	memcpy(&x, p, sizeof(x));
+	return x;
+}
+
+static void accumulate_scalar(
+	unsigned long long *lanes, unsigned char const *data, size_t stripes)
+{
+	for (size_t s = 0; s < stripes; s++, data += STRIPE_SIZE)
+	{
+		for (int i = 0; i < STRIPE_LANES; i++)
+		{
+			unsigned long long value = read64(data + i * 8);
+			unsigned long long keyed = value ^ stripe_key[i];
+
+			lanes[i ^ 1] += value;
+			lanes[i] += (keyed & 0xffffffff) * (keyed >> 32);
+		}
+	}
+}
+
+#ifdef CPU_X86_64
+
+static void accumulate_sse2(
+	unsigned long long *lanes, unsigned char const *data, size_t stripes)
+{
+	__m128i acc[4], key[4];
+
+	for (int i = 0; i < 4; i++)
+	{
+		acc[i] = _mm_loadu_si128((__m128i const*)lanes + i);
+		key[i] = _mm_loadu_si128((__m128i const*)stripe_key + i);
+	}
+
+	for (size_t s = 0; s < stripes; s++, data += STRIPE_SIZE)
+	{
+		for (int i = 0; i < 4; i++)
+		{
+			__m128i value = _mm_loadu_si128((__m128i const*)data + i);
+			__m128i keyed = _mm_xor_si128(value, key[i]);
+			__m128i product = _mm_mul_epu32(keyed, _mm_srli_epi64(keyed, 32));
+			__m128i swapped = _mm_shuffle_epi32(value, _MM_SHUFFLE(1, 0, 3, 2));
+
+			acc[i] = _mm_add_epi64(acc[i], _mm_add_epi64(product, swapped));
+		}
+	}
+
+	for (int i = 0; i < 4; i++)
+	{
+		_mm_storeu_si128((__m128i*)lanes + i, acc[i]);
+	}
+}
+
+CPU_TARGET_AVX2
+static void accumulate_avx2(
+	unsigned long long *lanes, unsigned char const *data, size_t stripes)
+{
+	__m256i acc[2], key[2];
+
+	for (int i = 0; i < 2; i++)
+	{
+		acc[i] = _mm256_loadu_si256((__m256i const*)lanes + i);
+		key[i] = _mm256_loadu_si256((__m256i const*)stripe_key + i);
+	}
+
+	for (size_t s = 0; s < stripes; s++, data += STRIPE_SIZE)
+	{
+		for (int i = 0; i < 2; i++)
+		{
+			__m256i value = _mm256_loadu_si256((__m256i const*)data + i);
+			__m256i keyed = _mm256_xor_si256(value, key[i]);
+			__m256i product =
+				_mm256_mul_epu32(keyed, _mm256_srli_epi64(keyed, 32));
+			__m256i swapped =
+				_mm256_shuffle_epi32(value, _MM_SHUFFLE(1, 0, 3, 2));
+
+			acc[i] = _mm256_add_epi64(
+				acc[i], _mm256_add_epi64(product, swapped));
+		}
+	}
+
+	for (int i = 0; i < 2; i++)
+	{
+		_mm256_storeu_si256((__m256i*)lanes + i, acc[i]);
+	}
+}
+
+#endif
+
+static unsigned long long xxh64_round(
+	unsigned long long acc, unsigned long long input)
+{
+	acc += input * PRIME64_2;
+	acc = rotate_left(acc, 31);
+	return acc * PRIME64_1;
+}
+
+int stripe_hash_kernel(
+	void const *data, size_t len, enum CHECKSUM_KERNEL kernel)
+{
+	unsigned char const *p = (unsigned char const*)data;
+	unsigned char const *end = p + len;
+	size_t stripes = len / STRIPE_SIZE;
+	Accumulate accumulate = accumulate_scalar;
+
+	unsigned long long lanes[STRIPE_LANES] =
+	{
+		PRIME64_3, PRIME64_1, PRIME64_2, PRIME64_3,
+		PRIME64_4, PRIME64_2, PRIME64_5, PRIME64_1,
+	};
+
+	if (kernel == CHECKSUM_KERNEL_best || kernel > checksum_best_kernel())
+	{
+		kernel = checksum_best_kernel();
+	}
+
+#ifdef CPU_X86_64
+	if (kernel == CHECKSUM_KERNEL_sse2)
+	{
+		accumulate = accumulate_sse2;
+	}
+	else if (kernel == CHECKSUM_KERNEL_avx2)
+	{
+		accumulate = accumulate_avx2;
+	}
+#endif
+
+	accumulate(lanes, p, stripes);
+	p += stripes * STRIPE_SIZE;
+
+	unsigned long long h = len * PRIME64_1;
+
+	for (int i = 0; i < STRIPE_LANES; i++)
+	{
+		h ^= xxh64_round(0, lanes[i]);
+		h = rotate_left(h, 27) * PRIME64_1 + PRIME64_4;
+	}
+
+	for (; end - p >= 8; p += 8)
+	{
+		h ^= xxh64_round(0, read64(p));
+		h = rotate_left(h, 27) * PRIME64_1 + PRIME64_4;
+	}
+
+	for (; p < end; p++)
+	{
+		h ^= *p * PRIME64_5;
+		h = rotate_left(h, 11) * PRIME64_1;
+	}
+
+	h ^= h >> 33;
+	h *= PRIME64_2;
+	h ^= h >> 29;
+	h *= PRIME64_3;
+	h ^= h >> 32;
+
+	return (int)(unsigned int)(h ^ (h >> 32));
+}
+
+int stripe_hash(void const *data, size_t len)
+{
+	return stripe_hash_kernel(data, len, CHECKSUM_KERNEL_best);
+}
+
+int compute_checksum(enum CHECKSUM kind, void const *data, size_t len)
+{
+	switch (kind)
+	{
+	case CHECKSUM_stripe:
+		return stripe_hash(data, len);
+
+	default:
+		return fletcher32_checksum((short const*)data, len / 2);
+	}
+}
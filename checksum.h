@@ -0,0 +1,68 @@
+#ifndef _CHECKSUM_H_
+#define _CHECKSUM_H_
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// How a session checksums its game states. All peers must use the same one,
+// as GGPO compares the values to detect desyncs.
+enum CHECKSUM
+{
+	CHECKSUM_fletcher32,
+	CHECKSUM_stripe,
+};
+
+enum CHECKSUM_KERNEL
+{
+	CHECKSUM_KERNEL_best = -1,
+	CHECKSUM_KERNEL_scalar,
+	CHECKSUM_KERNEL_sse2,
+	CHECKSUM_KERNEL_avx2,
+};
+
+// Fletcher reduces its sums at least this often, in words.
+#define FLETCHER32_BLOCK 360
+
+// The widest kernel this CPU can run.
+enum CHECKSUM_KERNEL checksum_best_kernel(void);
+
+// Over len shorts, not bytes. Uses the best kernel.
+int fletcher32_checksum(short const *data, size_t len);
+
+// Every kernel returns the same value as the scalar one. Kernels the CPU can't
+// run fall back to the best one it can.
+int fletcher32_checksum_kernel(
+	short const *data,
+	size_t len,
+	enum CHECKSUM_KERNEL kernel);
+
+// Over at most FLETCHER32_BLOCK words, the sum of the words and the sum of
+// each word weighted by len for the first one down to 1 for the last. Exact,
+// so blocks can be combined into a Fletcher checksum mod 65535.
+void fletcher32_block_sums(
+	short const *data,
+	int len,
+	int *sum,
+	int *weighted);
+
+// A multiply-accumulate hash after XXH3, over len bytes. At least as fast as
+// Fletcher on every kernel and far less prone to collisions, but a different
+// value. Every kernel returns the same one.
+int stripe_hash(void const *data, size_t len);
+
+int stripe_hash_kernel(
+	void const *data,
+	size_t len,
+	enum CHECKSUM_KERNEL kernel);
+
+// Over len bytes, which must be even for CHECKSUM_fletcher32.
+int compute_checksum(enum CHECKSUM kind, void const *data, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ifndef _CHECKSUM_H_
@@ -0,0 +1,42 @@
+#include <stdbool.h>
+#include "cpu.h"
+
+#if defined(CPU_X86_64) && defined(_MSC_VER)
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+
+int cpu_has_avx2(void)
+{
+#if defined(CPU_X86_64) && defined(_MSC_VER)
+	int info[4];
+
+	__cpuid(info, 0);
+
+	if (info[0] < 7)
+	{
+		return false;
+	}
+
+	// The OS has to save the upper halves of the YMM registers as well.
+	__cpuid(info, 1);
+
+	int osxsave = (info[2] >> 27) & 1;
+	int avx = (info[2] >> 28) & 1;
+
+	if (!osxsave || !avx || (_xgetbv(0) & 6) != 6)
+	{
+		return false;
+	}
+
+	__cpuidex(info, 7, 0);
+
+	return (info[1] >> 5) & 1;
+#elif defined(CPU_X86_64)
+	__builtin_cpu_init();
+
+	return __builtin_cpu_supports("avx2");
+#else
+	return false;
+#endif
+}
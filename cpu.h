@@ -0,0 +1,28 @@
+#ifndef _CPU_H_
+#define _CPU_H_
+
+// What the simulation's SIMD kernels may use. On x86-64 SSE2 is always there
+// and AVX2 is detected at run time; elsewhere only the scalar kernels exist.
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define CPU_X86_64 1
+#endif
+
+// Lets a single function use AVX2 without building the whole file for it.
+#if defined(__GNUC__) || defined(__clang__)
+#define CPU_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define CPU_TARGET_AVX2
+#endif
+
+int cpu_has_avx2(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ifndef _CPU_H_
@@ -1,25 +1,52 @@
-#include <SDL.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
-#include "connection_report.h"
+#include "bullets.h"
+#include "checksum.h"
 #include "game.h"
 #include "game_state.h"
-#include "renderer.h"
+#include "ship_grid.h"
+#include "snapshot_history.h"
+#include "snapshot_ring.h"
+#include "state_hash.h"
 #include "utils.h"
 
-GameState gs = { 0 };
+static GameState *gs = NULL;
 
-static double degtorad(double deg)
+// Views into gs, valid for the whole session.
+static Ship *ships = NULL;
+static Bullets bullets;
+
+static SnapshotRing snapshots;
+
+// Used instead of the ring once given a keyframe interval.
+static SnapshotHistory history;
+
+static enum BULLET_KERNEL bullet_kernel = BULLET_KERNEL_best;
+
+static enum CHECKSUM state_checksum = CHECKSUM_fletcher32;
+
+// Rebuilt every update, once all ships have moved.
+static ShipGrid ship_grid;
+
+// Whatever an update may have written is marked here, so that
+// game_state_hash only rehashes that.
+static StateHash state_hash;
+
+static void mark_dirty(void const *p, size_t len)
 {
-	return PI * deg / 180;
+	state_hash_mark(&state_hash,
+		(size_t)((unsigned char const*)p - (unsigned char const*)gs),
+		len);
 }
 
-static double distance(Position* lhs, Position* rhs)
+// The positions and flags of a word's worth of bullets.
+static void mark_bullets_moved(int w)
 {
-	double x = rhs->x - lhs->x;
-	double y = rhs->y - lhs->y;
-	return sqrt(x * x + y * y);
+	mark_dirty(bullets.x + w * 32, sizeof(Scalar) * 32);
+	mark_dirty(bullets.y + w * 32, sizeof(Scalar) * 32);
+	mark_dirty(bullets.active + w, sizeof(unsigned int));
 }
 
 static void inflate(Bounds* bounds, int dx, int dy)
@@ -30,48 +57,41 @@ static void inflate(Bounds* bounds, int dx, int dy)
 	bounds->bottom += dy;
 }
 
-static void init_game_state(SDL_Window* window, int num_players)
+static void init_game_state(int w, int h, int num_players)
 {
-	int w, h;
-	SDL_GetWindowSize(window, &w, &h);
-
 	Bounds bounds = { 0, 0, w, h };
-	gs.bounds = bounds;
+	gs->bounds = bounds;
 
-	inflate(&gs.bounds, -8, -8);
+	inflate(&gs->bounds, -8, -8);
 
 	int r = h / 4;
-	gs.frame_number = 0;
-	gs.num_ships = num_players;
+	gs->frame_number = 0;
 
-	for (int i = 0; i < gs.num_ships; i++)
+	for (int i = 0; i < gs->num_ships; i++)
 	{
 		int heading = i * 360 / num_players;
-		double theta = (double)heading * PI / 180;
-		double cost = cos(theta);
-		double sint = sin(theta);
-
-		gs.ships[i].position.x = (w / 2) + r * cost;
-		gs.ships[i].position.y = (h / 2) + r * sint;
-		gs.ships[i].heading = (heading + 180) % 360;
-		gs.ships[i].health = STARTING_HEALTH;
-		gs.ships[i].radius = SHIP_RADIUS;
+
+		ships[i].position.x = scalar_from_int(w / 2) + r * scalar_cos(heading);
+		ships[i].position.y = scalar_from_int(h / 2) + r * scalar_sin(heading);
+		ships[i].heading = (heading + 180) % 360;
+		ships[i].health = STARTING_HEALTH;
+		ships[i].radius = SHIP_RADIUS;
 	}
 
-	inflate(&gs.bounds, -8, -8);
+	inflate(&gs->bounds, -8, -8);
 }
 
-static void get_ship_ai(int i, double *heading, double *thrust, int *fire)
+static void get_ship_ai(int i, int *heading, Scalar *thrust, int *fire)
 {
-	*heading = (gs.ships[i].heading + 5) % 360;
+	*heading = (ships[i].heading + 5) % 360;
 	*thrust = 0;
 	*fire = 0;
 }
 
 static void parse_ship_inputs(
-	int inputs, int i, double *heading, double *thrust, int *fire)
+	int inputs, int i, int *heading, Scalar *thrust, int *fire)
 {
-	Ship *ship = gs.ships + i;
+	Ship *ship = ships + i;
 
 	if (inputs & INPUT_rotate_right) 
 	{
@@ -88,11 +108,11 @@ static void parse_ship_inputs(
 
 	if (inputs & INPUT_thrust) 
 	{
-		*thrust = SHIP_THRUST;
+		*thrust = SCALAR(SHIP_THRUST);
 	}
 	else if (inputs & INPUT_break) 
 	{
-		*thrust = -SHIP_THRUST;
+		*thrust = -SCALAR(SHIP_THRUST);
 	}
 	else {
 		*thrust = 0;
@@ -101,28 +121,34 @@ static void parse_ship_inputs(
 	*fire = inputs & INPUT_fire;
 }
 
-static void move_ship(int which, double heading, double thrust, int fire)
+static void move_ship(int which, int heading, Scalar thrust, int fire)
 {
-	Ship* ship = gs.ships + which;
+	Ship* ship = ships + which;
 
-	ship->heading = (int)heading;
+	mark_dirty(ship, sizeof(Ship));
+	ship->heading = heading;
 
 	if (ship->cooldown == 0)
 	{
 		if (fire)
 		{
-			for (int i = 0; i < MAX_BULLETS; i++)
+			int first = which * gs->max_bullets;
+
+			for (int i = first; i < first + gs->max_bullets; i++)
 			{
-				double dx = cos(degtorad(ship->heading));
-				double dy = sin(degtorad(ship->heading));
+				Scalar dx = scalar_cos(ship->heading);
+				Scalar dy = scalar_sin(ship->heading);
 
-				if (!ship->bullets[i].active)
+				if (!bullet_is_active(&bullets, i))
 				{
-					ship->bullets[i].active = true;
-					ship->bullets[i].position.x = ship->position.x + (ship->radius * dx);
-					ship->bullets[i].position.y = ship->position.y + (ship->radius * dy);
-					ship->bullets[i].velocity.dx = ship->velocity.dx + (BULLET_SPEED * dx);
-					ship->bullets[i].velocity.dy = ship->velocity.dy + (BULLET_SPEED * dy);
+					mark_dirty(bullets.dx + i, sizeof(Scalar));
+					mark_dirty(bullets.dy + i, sizeof(Scalar));
+					mark_bullets_moved(i / 32);
+					bullet_set_active(&bullets, i, true);
+					bullets.x[i] = ship->position.x + (ship->radius * dx);
+					bullets.y[i] = ship->position.y + (ship->radius * dy);
+					bullets.dx[i] = ship->velocity.dx + (BULLET_SPEED * dx);
+					bullets.dy[i] = ship->velocity.dy + (BULLET_SPEED * dy);
 					ship->cooldown = BULLET_COOLDOWN;
 					break;
 				}
@@ -132,186 +158,158 @@ static void move_ship(int which, double heading, double thrust, int fire)
 
 	if (thrust)
 	{
-		double dx = thrust * cos(degtorad(heading));
-		double dy = thrust * sin(degtorad(heading));
+		Scalar dx = scalar_mul(thrust, scalar_cos(heading));
+		Scalar dy = scalar_mul(thrust, scalar_sin(heading));
 
 		ship->velocity.dx += dx;
 		ship->velocity.dy += dy;
 
-		double mag = sqrt(
-			ship->velocity.dx * ship->velocity.dx +
-			ship->velocity.dy * ship->velocity.dy);
+		Scalar mag = scalar_length(ship->velocity.dx, ship->velocity.dy);
 
-		if (mag > SHIP_MAX_THRUST)
+		if (mag > SCALAR(SHIP_MAX_THRUST))
 		{
-			ship->velocity.dx = (ship->velocity.dx * SHIP_MAX_THRUST) / mag;
-			ship->velocity.dy = (ship->velocity.dy * SHIP_MAX_THRUST) / mag;
+			ship->velocity.dx = scalar_div(
+				scalar_mul(ship->velocity.dx, SCALAR(SHIP_MAX_THRUST)), mag);
+			ship->velocity.dy = scalar_div(
+				scalar_mul(ship->velocity.dy, SCALAR(SHIP_MAX_THRUST)), mag);
 		}
 	}
 
 	ship->position.x += ship->velocity.dx;
 	ship->position.y += ship->velocity.dy;
 
-	if (ship->position.x - ship->radius < gs.bounds.left ||
-		ship->position.x + ship->radius > gs.bounds.right)
+	Scalar radius = scalar_from_int(ship->radius);
+
+	if (ship->position.x - radius < scalar_from_int(gs->bounds.left) ||
+		ship->position.x + radius > scalar_from_int(gs->bounds.right))
 	{
-		ship->velocity.dx *= -1;
+		ship->velocity.dx = -ship->velocity.dx;
 		ship->position.x += (ship->velocity.dx * 2);
 	}
-	if (ship->position.y - ship->radius < gs.bounds.top ||
-		ship->position.y + ship->radius > gs.bounds.bottom)
+	if (ship->position.y - radius < scalar_from_int(gs->bounds.top) ||
+		ship->position.y + radius > scalar_from_int(gs->bounds.bottom))
 	{
-		ship->velocity.dy *= -1;
+		ship->velocity.dy = -ship->velocity.dy;
 		ship->position.y += (ship->velocity.dy * 2);
 	}
-	for (int i = 0; i < MAX_BULLETS; i++)
+}
+
+static void collide_bullets()
+{
+	for (int w = 0; w < bullets.capacity / 32; w++)
 	{
-		Bullet* bullet = ship->bullets + i;
-		if (bullet->active)
+		for (int lane = 0; lane < 32 && (bullets.active[w] >> lane); lane++)
 		{
-			bullet->position.x += bullet->velocity.dx;
-			bullet->position.y += bullet->velocity.dy;
+			int i = w * 32 + lane;
 
-			if (bullet->position.x < gs.bounds.left ||
-				bullet->position.y < gs.bounds.top ||
-				bullet->position.x > gs.bounds.right ||
-				bullet->position.y > gs.bounds.bottom)
+			if (!bullet_is_active(&bullets, i))
 			{
-				bullet->active = false;
+				continue;
 			}
-			else
+
+			int j = ship_grid_first_hit(
+				&ship_grid, ships, bullets.x[i], bullets.y[i]);
+
+			if (j >= 0)
 			{
-				for (int j = 0; j < gs.num_ships; j++)
-				{
-					Ship* other = gs.ships + j;
-
-					if (distance(&bullet->position, &other->position) <
-						other->radius)
-					{
-						ship->score++;
-						other->health -= BULLET_DAMAGE;
-						bullet->active = false;
-						break;
-					}
-				}
+				ships[i / gs->max_bullets].score++;
+				ships[j].health -= BULLET_DAMAGE;
+				bullet_set_active(&bullets, i, false);
 			}
 		}
 	}
 }
 
-static void update_game_state(int const *inputs, int disconnect_flags)
+static void update_game_state(LocalInput const *inputs, int disconnect_flags)
 {
-	gs.frame_number++;
+	gs->frame_number++;
+	mark_dirty(gs, sizeof(GameState));
 
-	for (int i = 0; i < gs.num_ships; i++)
+	for (int i = 0; i < gs->num_ships; i++)
 	{
-		double thrust, heading;
-		int fire;
+		Scalar thrust;
+		int heading, fire;
 
-		if (disconnect_flags & (1 << i))
+		if (i < 32 && (disconnect_flags & (1u << i)))
 		{
 			get_ship_ai(i, &heading, &thrust, &fire);
 		}
 		else
 		{
-			parse_ship_inputs(inputs[i], i, &heading, &thrust, &fire);
+			parse_ship_inputs(inputs[i].inputs, i, &heading, &thrust, &fire);
 		}
 
 		move_ship(i, heading, thrust, fire);
 
-		if (gs.ships[i].cooldown)
+		if (ships[i].cooldown)
 		{
-			gs.ships[i].cooldown--;
+			ships[i].cooldown--;
 		}
 	}
-}
 
-// See http://en.wikipedia.org/wiki/Fletcher%27s_checksum.
-static int fletcher32_checksum(short const *data, size_t len)
-{
-	int sum1 = 0xffff, sum2 = 0xffff;
+	ship_grid_build(&ship_grid, ships, gs->num_ships, &gs->bounds);
 
-	while (len)
+	for (int w = 0; w < bullets.capacity / 32; w++)
 	{
-		size_t tlen = len > 360 ? 360 : len;
-		len -= tlen;
-
-		do
+		if (bullets.active[w])
 		{
-			sum1 += *data++;
-			sum2 += sum1;
-		} while (--tlen);
-
-		sum1 = (sum1 & 0xffff) + (sum1 >> 16);
-		sum2 = (sum2 & 0xffff) + (sum2 >> 16);
+			mark_bullets_moved(w);
+		}
 	}
 
-	// Second reduction step to reduce sums to 16 bits.
-	sum1 = (sum1 & 0xffff) + (sum1 >> 16);
-	sum2 = (sum2 & 0xffff) + (sum2 >> 16);
-	return sum2 << 16 | sum1;
+	bullets_integrate(&bullets, &gs->bounds, bullet_kernel);
+	collide_bullets();
 }
 
-void buffer_event(SDL_Event const *e, LocalInput* input)
+void step_game(LocalInput const* inputs, int disconnect_flags)
 {
-	(void)input; (void)e;
+	update_game_state(inputs, disconnect_flags);
 }
 
-void capture_input_state(LocalInput *input)
+GameState const *game_state()
 {
-	static const struct
-	{
-		int key;
-		int input;
-	} inputtable[] =
-	{
-	   { SDL_SCANCODE_UP,       INPUT_thrust },
-	   { SDL_SCANCODE_DOWN,     INPUT_break },
-	   { SDL_SCANCODE_LEFT,     INPUT_rotate_left },
-	   { SDL_SCANCODE_RIGHT,    INPUT_rotate_right },
-	   { SDL_SCANCODE_D,        INPUT_fire },
-	   { SDL_SCANCODE_S,        INPUT_bomb },
-	};
-
-	const Uint8* states = SDL_GetKeyboardState(NULL);
-	int inputs = 0;
-
-	for (int i = 0; i < COUNT_OF(inputtable); i++)
-	{
-		if (states[inputtable[i].key])
-		{
-			inputs |= inputtable[i].input;
-		}
-	}
-
-	input->inputs = inputs;
+	return gs;
 }
 
-void step_game(LocalInput const* inputs, int disconnect_flags)
+int setup_game(int width, int height, int num_players, int max_bullets)
 {
-	int gs_inputs[MAX_PLAYERS] = { 0 };
+	int size = game_state_size(num_players, max_bullets);
 
-	for (int i = 0; i < MAX_PLAYERS; i++)
+	gs = (GameState*)calloc(1, size);
+
+	if (!gs ||
+		!ship_grid_create(&ship_grid, num_players) ||
+		!state_hash_create(&state_hash, size))
 	{
-		gs_inputs[i] = inputs[i].inputs;
+		tear_down_game();
+		return false;
 	}
 
-	update_game_state(gs_inputs, disconnect_flags);
-}
+	gs->size = size;
+	gs->num_ships = num_players;
+	gs->max_bullets = max_bullets;
+	gs->bullet_capacity =
+		game_state_bullet_capacity(num_players, max_bullets);
 
-void draw_game(SDL_Renderer* renderer, ConnectionReport const* connection_report)
-{
-	draw(renderer, &gs, connection_report);
-}
+	ships = game_state_ships(gs);
+	bullets = game_state_bullets(gs);
 
-void setup_game(SDL_Window* window, int num_players)
-{
-	init_game_state(window, num_players);
+	init_game_state(width, height, num_players);
+	snapshot_ring_create(&snapshots, size);
+
+	return true;
 }
 
 void tear_down_game()
 {
-	memset(&gs, 0, sizeof(gs));
+	snapshot_ring_destroy(&snapshots);
+	snapshot_history_destroy(&history);
+	ship_grid_destroy(&ship_grid);
+	state_hash_destroy(&state_hash);
+	free(gs);
+	gs = NULL;
+	ships = NULL;
+	memset(&bullets, 0, sizeof(bullets));
 }
 
 int begin_game(const char* game)
@@ -322,38 +320,75 @@ int begin_game(const char* game)
 
 int load_game_state(unsigned char* buffer, int len)
 {
-	memcpy(&gs, buffer, len);
+	if (len != gs->size)
+	{
+		return false;
+	}
+
+	if (history.keyframe_interval)
+	{
+		snapshot_history_load(&history, buffer, gs);
+	}
+	else
+	{
+		memcpy(gs, buffer, len);
+	}
+
+	state_hash_mark_all(&state_hash);
 	return true;
 }
 
 int save_game_state(unsigned char** buffer, int* len, int* checksum, int frame)
 {
-	(void)frame;
+	*len = gs->size;
+
+	if (history.keyframe_interval)
+	{
+		*buffer = snapshot_history_save(&history, gs);
+	}
+	else
+	{
+		*buffer = snapshot_ring_acquire(&snapshots, frame, *len);
 
-	*len = sizeof(gs);
-	*buffer = (unsigned char*)malloc(*len);
+		if (*buffer)
+		{
+			memcpy(*buffer, gs, *len);
+		}
+	}
 
 	if (!*buffer)
 	{
 		return false;
 	}
 
-	memcpy(*buffer, &gs, *len);
-	*checksum = fletcher32_checksum((short*)*buffer, *len / 2);
+	*checksum = game_state_hash();
 
 	return true;
 }
 
 int log_game_state(char* filename, unsigned char* buffer, int len)
 {
-	(void)len;
+	unsigned char* state = buffer;
+
+	// A handle into the history, rather than the state itself.
+	if (history.keyframe_interval)
+	{
+		state = (unsigned char*)malloc(len);
+
+		if (!state)
+		{
+			return false;
+		}
+
+		snapshot_history_restore(&history, buffer, state);
+	}
 
 	FILE* fp = NULL;
 	fopen_s(&fp, filename, "w");
 
 	if (fp)
 	{
-		GameState* in_gs = (GameState*)buffer;
+		GameState* in_gs = (GameState*)state;
 
 		fprintf(fp, "GameState object.\n");
 		fprintf(fp, "  bounds: %d,%d x %d,%d.\n",
@@ -364,15 +399,22 @@ int log_game_state(char* filename, unsigned char* buffer, int len)
 
 		fprintf(fp, "  num_ships: %d.\n", in_gs->num_ships);
 
+		Ship* in_ships = game_state_ships(in_gs);
+		Bullets in_bullets = game_state_bullets(in_gs);
+
 		for (int i = 0; i < in_gs->num_ships; i++)
 		{
-			Ship* ship = in_gs->ships + i;
+			Ship* ship = in_ships + i;
 
 			fprintf(fp, "  ship %d position:  %.4f, %.4f\n",
-				i, ship->position.x, ship->position.y);
+				i,
+				scalar_to_double(ship->position.x),
+				scalar_to_double(ship->position.y));
 
 			fprintf(fp, "  ship %d velocity:  %.4f, %.4f\n",
-				i, ship->velocity.dx, ship->velocity.dy);
+				i,
+				scalar_to_double(ship->velocity.dx),
+				scalar_to_double(ship->velocity.dy));
 
 			fprintf(fp, "  ship %d radius:    %d.\n", i, ship->radius);
 			fprintf(fp, "  ship %d heading:   %d.\n", i, ship->heading);
@@ -381,36 +423,92 @@ int log_game_state(char* filename, unsigned char* buffer, int len)
 			fprintf(fp, "  ship %d cooldown:  %d.\n", i, ship->cooldown);
 			fprintf(fp, "  ship %d score:     %d.\n", i, ship->score);
 
-			for (int j = 0; j < MAX_BULLETS; j++)
+			for (int j = 0; j < in_gs->max_bullets; j++)
 			{
-				Bullet* bullet = ship->bullets + j;
+				int k = i * in_gs->max_bullets + j;
 				fprintf(
 					fp,
 					"  ship %d bullet %d: %.2f %.2f -> %.2f %.2f.\n",
 					i,
 					j,
-					bullet->position.x, bullet->position.y,
-					bullet->velocity.dx, bullet->velocity.dy);
+					scalar_to_double(in_bullets.x[k]),
+					scalar_to_double(in_bullets.y[k]),
+					scalar_to_double(in_bullets.dx[k]),
+					scalar_to_double(in_bullets.dy[k]));
 			}
 		}
 
 		fclose(fp);
 	}
 
+	if (state != buffer)
+	{
+		free(state);
+	}
+
 	return true;
 }
 
 void free_game_state(void* buffer)
 {
-	free(buffer);
+	if (history.keyframe_interval)
+	{
+		snapshot_history_release(&history, (unsigned char*)buffer);
+	}
+	else
+	{
+		snapshot_ring_release(&snapshots, buffer);
+	}
+}
+
+int game_set_snapshot_keyframes(int interval)
+{
+	snapshot_history_destroy(&history);
+
+	return interval <= 0 ||
+		snapshot_history_create(&history, gs->size, interval);
+}
+
+void game_snapshot_stats(SnapshotStats *stats)
+{
+	stats->allocations_avoided = snapshots.allocations_avoided;
+	stats->heap_allocations = snapshots.heap_allocations;
+
+	if (history.keyframe_interval)
+	{
+		stats->retained_frames = history.retained_frames;
+		stats->retained_bytes = history.retained_bytes;
+	}
+	else
+	{
+		stats->retained_frames = snapshots.outstanding;
+		stats->retained_bytes =
+			(long long)snapshots.outstanding * snapshots.slot_size;
+	}
 }
 
 int game_frame_number()
 {
-	return gs.frame_number;
+	return gs->frame_number;
+}
+
+void game_set_bullet_kernel(int kernel)
+{
+	bullet_kernel = (enum BULLET_KERNEL)kernel;
+}
+
+void game_set_checksum(int kind)
+{
+	state_checksum = (enum CHECKSUM)kind;
 }
 
 int game_state_hash()
 {
-	return fletcher32_checksum((short*)&gs, sizeof(gs) / 2);
+	// Only Fletcher can be kept up to date block by block.
+	if (state_checksum == CHECKSUM_fletcher32)
+	{
+		return state_hash_value(&state_hash, gs);
+	}
+
+	return compute_checksum(state_checksum, gs, gs->size);
 }
@@ -6,20 +6,60 @@ extern "C"
 {
 #endif
 
-#define MAX_PLAYERS 4
+struct ConnectionReport;
+struct GameState;
+struct SDL_Renderer;
+union SDL_Event;
+
 #define GAME_NAME   "vectorwar"
 
+#define DEFAULT_MAX_BULLETS 30
+
 typedef struct LocalInput {
 	int inputs;
 } LocalInput;
 
+typedef struct SnapshotStats {
+	long long allocations_avoided;
+	long long heap_allocations;
+	// Saved states still held, by GGPO or as the base of a held delta.
+	int retained_frames;
+	long long retained_bytes;
+} SnapshotStats;
+
 extern const char game_name[];
 
 int game_frame_number();
 
+// The game state's checksum, as picked by game_set_checksum, and the same
+// one save_game_state hands to GGPO, so that a hash shown for a frame is the
+// one GGPO compares. Fletcher is taken mod 65535 and kept up to date by
+// rehashing only what changed since it was last asked for, or everything
+// after a load. Stripe is taken over the whole state every time.
 int game_state_hash();
 
-void setup_game(struct SDL_Window *window, int num_players);
+struct GameState const *game_state();
+
+void game_snapshot_stats(SnapshotStats *stats);
+
+// Picks how bullets are moved, see BULLET_KERNEL in bullets.h. Defaults to the
+// best the CPU supports. All kernels yield the same game_state_hash.
+void game_set_bullet_kernel(int kernel);
+
+// Picks how game states are checksummed, see CHECKSUM in checksum.h. Defaults
+// to Fletcher. Every peer of a session must pick the same.
+void game_set_checksum(int kind);
+
+// Saves a full copy every interval saves and deltas in between, trading
+// time spent in saves and loads for memory. 0, the default, saves full
+// copies only. Call after setup_game, before any state is saved. Returns
+// false if out of memory.
+int game_set_snapshot_keyframes(int interval);
+
+// Every peer of a session must agree on all of these. num_players and
+// max_bullets size the game state, width and height are those of the arena.
+// Returns false if the state can't be allocated.
+int setup_game(int width, int height, int num_players, int max_bullets);
 
 void tear_down_game();
 
@@ -27,6 +67,7 @@ void buffer_event(union SDL_Event const *event, LocalInput *input);
 
 void capture_input_state(LocalInput *input);
 
+// Takes one input per player. Players past the 32nd can't be disconnected.
 void step_game(LocalInput const *inputs, int disconnect_flags);
 
 void draw_game(
@@ -0,0 +1,49 @@
+#include <SDL.h>
+#include "connection_report.h"
+#include "game.h"
+#include "game_state.h"
+#include "renderer.h"
+#include "utils.h"
+
+// The half of the game that talks to SDL, kept apart from game.c so that the
+// simulation builds without it.
+
+void buffer_event(SDL_Event const *e, LocalInput* input)
+{
+	(void)input; (void)e;
+}
+
+void capture_input_state(LocalInput *input)
+{
+	static const struct
+	{
+		int key;
+		int input;
+	} inputtable[] =
+	{
+	   { SDL_SCANCODE_UP,       INPUT_thrust },
+	   { SDL_SCANCODE_DOWN,     INPUT_break },
+	   { SDL_SCANCODE_LEFT,     INPUT_rotate_left },
+	   { SDL_SCANCODE_RIGHT,    INPUT_rotate_right },
+	   { SDL_SCANCODE_D,        INPUT_fire },
+	   { SDL_SCANCODE_S,        INPUT_bomb },
+	};
+
+	const Uint8* states = SDL_GetKeyboardState(NULL);
+	int inputs = 0;
+
+	for (int i = 0; i < COUNT_OF(inputtable); i++)
+	{
+		if (states[inputtable[i].key])
+		{
+			inputs |= inputtable[i].input;
+		}
+	}
+
+	input->inputs = inputs;
+}
+
+void draw_game(SDL_Renderer* renderer, ConnectionReport const* connection_report)
+{
+	draw(renderer, game_state(), connection_report);
+}
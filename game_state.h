@@ -1,6 +1,9 @@
 #ifndef _GAMESTATE_H_
 #define _GAMESTATE_H_
 
+#include <stddef.h>
+#include "scalar.h"
+
 #define PI              ((double)3.1415926)
 #define STARTING_HEALTH        100
 #define ROTATE_INCREMENT         3
@@ -11,10 +14,8 @@
 #define SHIP_MAX_THRUST          4.0
 #define SHIP_BREAK_SPEED         0.6
 #define BULLET_SPEED             5
-#define MAX_BULLETS             30
 #define BULLET_COOLDOWN          8
 #define BULLET_DAMAGE           10
-#define MAX_SHIPS                4
 
 enum INPUT
 {
@@ -28,21 +29,14 @@ enum INPUT
 
 typedef struct Position
 {
-	double x, y;
+	Scalar x, y;
 } Position;
 
 typedef struct Velocity 
 {
-	double dx, dy;
+	Scalar dx, dy;
 } Velocity;
 
-typedef struct Bullet 
-{
-	int active;
-	Position position;
-	Velocity velocity;
-} Bullet;
-
 typedef struct Ship 
 {
 	Position position;
@@ -52,24 +46,98 @@ typedef struct Ship
 	int health;
 	int speed;
 	int cooldown;
-	Bullet bullets[MAX_BULLETS];
 	int score;
 } Ship;
 
+// Plain ints, so the layout of the state doesn't depend on the data model.
 typedef struct Bounds
 {
-	long left;
-	long top;
-	long right;
-	long bottom;
+	int left;
+	int top;
+	int right;
+	int bottom;
 } Bounds;
 
+// A game state is one contiguous blob sized for its session, so that saving,
+// loading and hashing it covers nothing but live entities. This header is
+// followed by num_ships ships, then by the bullet arrays, each
+// bullet_capacity long. Ship i owns the max_bullets bullets from
+// i * max_bullets.
 typedef struct GameState
 {
+	int size;
 	int frame_number;
 	Bounds bounds;
 	int num_ships;
-	Ship ships[MAX_SHIPS];
+	int max_bullets;
+	int bullet_capacity;
 } GameState;
 
+// Structure of arrays, so that bullets can be moved and culled in bulk. A view
+// into a game state, see game_state_bullets.
+typedef struct Bullets
+{
+	int capacity;
+	Scalar *x;
+	Scalar *y;
+	Scalar *dx;
+	Scalar *dy;
+	unsigned int *active;
+} Bullets;
+
+#define GAME_STATE_HEADER_SIZE ((sizeof(GameState) + 7) & ~(size_t)7)
+
+// Rounded up to whole words of the active mask.
+static inline int game_state_bullet_capacity(int num_ships, int max_bullets)
+{
+	return (num_ships * max_bullets + 31) / 32 * 32;
+}
+
+static inline int game_state_size(int num_ships, int max_bullets)
+{
+	int capacity = game_state_bullet_capacity(num_ships, max_bullets);
+
+	return (int)(GAME_STATE_HEADER_SIZE +
+		sizeof(Ship) * num_ships +
+		sizeof(Scalar) * capacity * 4 +
+		sizeof(unsigned int) * (capacity / 32));
+}
+
+static inline Ship *game_state_ships(GameState const *gs)
+{
+	return (Ship*)((char*)gs + GAME_STATE_HEADER_SIZE);
+}
+
+static inline Bullets game_state_bullets(GameState const *gs)
+{
+	Scalar *first = (Scalar*)(game_state_ships(gs) + gs->num_ships);
+	Bullets bullets;
+
+	bullets.capacity = gs->bullet_capacity;
+	bullets.x = first;
+	bullets.y = first + gs->bullet_capacity;
+	bullets.dx = first + gs->bullet_capacity * 2;
+	bullets.dy = first + gs->bullet_capacity * 3;
+	bullets.active = (unsigned int*)(first + gs->bullet_capacity * 4);
+
+	return bullets;
+}
+
+static inline int bullet_is_active(Bullets const *bullets, int i)
+{
+	return (bullets->active[i / 32] >> (i % 32)) & 1;
+}
+
+static inline void bullet_set_active(Bullets *bullets, int i, int active)
+{
+	if (active)
+	{
+		bullets->active[i / 32] |= 1u << (i % 32);
+	}
+	else
+	{
+		bullets->active[i / 32] &= ~(1u << (i % 32));
+	}
+}
+
 #endif // ifndef _GAMESTATE_H_
@@ -0,0 +1,253 @@
+#include <stdlib.h>
+#include <string.h>
+#include "ggpo_rollback.h"
+#include "predictors.h"
+#include "rollback_udp.h"
+
+// The GGPO API over the in-tree rollback session and UDP, so that the client
+// can link either. Spectating and sync testing aren't supported.
+
+struct GGPOSession
+{
+	RollbackSession *rollback;
+	UdpTransport udp;
+	HoldPredictor hold;
+	LearnedPredictor learned;
+	int hold_index;
+	int learned_index;
+};
+
+GGPOErrorCode __cdecl ggpo_start_session(
+	GGPOSession **session,
+	GGPOSessionCallbacks *cb,
+	const char *game,
+	int num_players,
+	int input_size,
+	unsigned short localport)
+{
+	(void)game;
+
+	GGPOSession *s = (GGPOSession*)calloc(1, sizeof(GGPOSession));
+
+	if (!s)
+	{
+		return GGPO_ERRORCODE_GENERAL_FAILURE;
+	}
+
+	if (!udp_transport_create(&s->udp, localport))
+	{
+		free(s);
+		return GGPO_ERRORCODE_GENERAL_FAILURE;
+	}
+
+	RollbackTransport transport = udp_transport_interface(&s->udp);
+	GGPOErrorCode result = rollback_start_session(
+		&s->rollback, cb, &transport, num_players, input_size);
+
+	if (!GGPO_SUCCEEDED(result))
+	{
+		udp_transport_destroy(&s->udp);
+		free(s);
+		return result;
+	}
+
+	if (!hold_predictor_create(&s->hold, num_players, input_size) ||
+		!learned_predictor_create(&s->learned, num_players, input_size))
+	{
+		ggpo_close_session(s);
+		return GGPO_ERRORCODE_GENERAL_FAILURE;
+	}
+
+	RollbackPredictor hold = hold_predictor_interface(&s->hold);
+	RollbackPredictor learned = learned_predictor_interface(&s->learned);
+
+	rollback_add_predictor(s->rollback, &hold, &s->hold_index);
+	rollback_add_predictor(s->rollback, &learned, &s->learned_index);
+
+	*session = s;
+
+	return GGPO_OK;
+}
+
+GGPOErrorCode __cdecl ggpo_add_player(
+	GGPOSession *session,
+	GGPOPlayer *player,
+	GGPOPlayerHandle *handle)
+{
+	int peer = -1;
+
+	if (player->type == GGPO_PLAYERTYPE_REMOTE)
+	{
+		peer = udp_transport_add_peer(
+			&session->udp, player->u.remote.ip_address, player->u.remote.port);
+
+		if (peer < 0)
+		{
+			return GGPO_ERRORCODE_INVALID_REQUEST;
+		}
+	}
+
+	return rollback_add_player(session->rollback, player, peer, handle);
+}
+
+GGPOErrorCode __cdecl ggpo_start_synctest(
+	GGPOSession **session,
+	GGPOSessionCallbacks *cb,
+	char *game,
+	int num_players,
+	int input_size,
+	int frames)
+{
+	(void)session, (void)cb, (void)game;
+	(void)num_players, (void)input_size, (void)frames;
+
+	return GGPO_ERRORCODE_UNSUPPORTED;
+}
+
+GGPOErrorCode __cdecl ggpo_start_spectating(
+	GGPOSession **session,
+	GGPOSessionCallbacks *cb,
+	const char *game,
+	int num_players,
+	int input_size,
+	unsigned short local_port,
+	char *host_ip,
+	unsigned short host_port)
+{
+	(void)session, (void)cb, (void)game, (void)num_players;
+	(void)input_size, (void)local_port, (void)host_ip, (void)host_port;
+
+	return GGPO_ERRORCODE_UNSUPPORTED;
+}
+
+GGPOErrorCode __cdecl ggpo_close_session(GGPOSession *session)
+{
+	rollback_close_session(session->rollback);
+	udp_transport_destroy(&session->udp);
+	hold_predictor_destroy(&session->hold);
+	learned_predictor_destroy(&session->learned);
+	free(session);
+
+	return GGPO_OK;
+}
+
+GGPOErrorCode __cdecl ggpo_set_frame_delay(
+	GGPOSession *session,
+	GGPOPlayerHandle player,
+	int frame_delay)
+{
+	return rollback_set_frame_delay(session->rollback, player, frame_delay);
+}
+
+GGPOErrorCode __cdecl ggpo_set_adaptive_frame_delay(
+	GGPOSession *session,
+	GGPOPlayerHandle player,
+	int min_frame_delay,
+	int max_frame_delay)
+{
+	return rollback_set_adaptive_frame_delay(
+		session->rollback, player, min_frame_delay, max_frame_delay);
+}
+
+// Never blocks, so the timeout is of no use.
+GGPOErrorCode __cdecl ggpo_idle(GGPOSession *session, int timeout)
+{
+	(void)timeout;
+
+	return rollback_idle(session->rollback);
+}
+
+GGPOErrorCode __cdecl ggpo_add_local_input(
+	GGPOSession *session,
+	GGPOPlayerHandle player,
+	void *values,
+	int size)
+{
+	return rollback_add_local_input(session->rollback, player, values, size);
+}
+
+GGPOErrorCode __cdecl ggpo_synchronize_input(
+	GGPOSession *session,
+	void *values,
+	int size,
+	int *disconnect_flags)
+{
+	return rollback_synchronize_input(
+		session->rollback, values, size, disconnect_flags);
+}
+
+GGPOErrorCode __cdecl ggpo_disconnect_player(
+	GGPOSession *session,
+	GGPOPlayerHandle player)
+{
+	return rollback_disconnect_player(session->rollback, player);
+}
+
+GGPOErrorCode __cdecl ggpo_advance_frame(GGPOSession *session)
+{
+	return rollback_advance_frame(session->rollback);
+}
+
+GGPOErrorCode __cdecl ggpo_get_network_stats(
+	GGPOSession *session,
+	GGPOPlayerHandle player,
+	GGPONetworkStats *stats)
+{
+	return rollback_get_network_stats(session->rollback, player, stats);
+}
+
+GGPOErrorCode __cdecl ggpo_set_disconnect_timeout(
+	GGPOSession *session,
+	int timeout)
+{
+	return rollback_set_disconnect_timeout(session->rollback, timeout);
+}
+
+GGPOErrorCode __cdecl ggpo_set_disconnect_notify_start(
+	GGPOSession *session,
+	int timeout)
+{
+	return rollback_set_disconnect_notify_start(session->rollback, timeout);
+}
+
+GGPOErrorCode __cdecl ggpo_get_rollback_stats(
+	GGPOSession *session,
+	RollbackStats *stats)
+{
+	rollback_get_stats(session->rollback, stats);
+
+	return GGPO_OK;
+}
+
+GGPOErrorCode __cdecl ggpo_use_predictor(
+	GGPOSession *session,
+	const char *name)
+{
+	if (!strcmp(name, "repeat"))
+	{
+		return rollback_use_predictor(session->rollback, 0);
+	}
+
+	if (!strcmp(name, "hold"))
+	{
+		return rollback_use_predictor(session->rollback, session->hold_index);
+	}
+
+	if (!strcmp(name, "learned"))
+	{
+		return rollback_use_predictor(
+			session->rollback, session->learned_index);
+	}
+
+	return GGPO_ERRORCODE_INVALID_REQUEST;
+}
+
+void __cdecl ggpo_log(GGPOSession *session, const char *fmt, ...)
+{
+	(void)session, (void)fmt;
+}
+
+void __cdecl ggpo_logv(GGPOSession *session, const char *fmt, va_list args)
+{
+	(void)session, (void)fmt, (void)args;
+}
@@ -0,0 +1,35 @@
+#ifndef _GGPO_ROLLBACK_H_
+#define _GGPO_ROLLBACK_H_
+
+#include "rollback.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// What the in-tree rollback session adds to the GGPO API.
+
+GGPOErrorCode __cdecl ggpo_get_rollback_stats(
+	GGPOSession *session,
+	RollbackStats *stats);
+
+// Picks how the inputs of remote players are guessed, out of "repeat",
+// "hold" and "learned", see predictors.h. All of them guess all along, and
+// rollback stats tell how often each was wrong.
+GGPOErrorCode __cdecl ggpo_use_predictor(
+	GGPOSession *session,
+	const char *name);
+
+// Lets the input delay of the local player follow the network and the cost
+// of rollbacks, see rollback_set_adaptive_frame_delay.
+GGPOErrorCode __cdecl ggpo_set_adaptive_frame_delay(
+	GGPOSession *session,
+	GGPOPlayerHandle player,
+	int min_frame_delay,
+	int max_frame_delay);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ifndef _GGPO_ROLLBACK_H_
@@ -0,0 +1,75 @@
+#include <imgui.h>
+#include <stdio.h>
+#include <string.h>
+#include "hud_text.h"
+#include "utils.h"
+
+static HudTextStats counts;
+
+static void measure(HudText *text)
+{
+	ImVec2 size = ImGui::CalcTextSize(text->text);
+
+	text->width = size.x;
+	text->height = size.y;
+	counts.measured++;
+}
+
+HudText const *hud_text_format(HudText *text, char const *format, int a, int b)
+{
+	float font_size = ImGui::GetFontSize();
+
+	if (text->valid &&
+		text->format == format &&
+		text->values[0] == a &&
+		text->values[1] == b &&
+		text->font_size == font_size)
+	{
+		counts.formats_saved++;
+		counts.measures_saved++;
+		return text;
+	}
+
+	sprintf_s(text->text, sizeof text->text, format, a, b);
+	counts.formatted++;
+
+	measure(text);
+
+	text->valid = true;
+	text->format = format;
+	text->values[0] = a;
+	text->values[1] = b;
+	text->font_size = font_size;
+
+	return text;
+}
+
+HudText const *hud_text_string(HudText *text, char const *string)
+{
+	float font_size = ImGui::GetFontSize();
+
+	if (text->valid &&
+		!text->format &&
+		text->font_size == font_size &&
+		!strncmp(text->text, string, sizeof text->text - 1))
+	{
+		counts.measures_saved++;
+		return text;
+	}
+
+	snprintf(text->text, sizeof text->text, "%s", string);
+
+	measure(text);
+
+	text->valid = true;
+	text->format = NULL;
+	text->font_size = font_size;
+
+	return text;
+}
+
+void hud_text_stats(HudTextStats *stats)
+{
+	*stats = counts;
+	memset(&counts, 0, sizeof(counts));
+}
@@ -0,0 +1,52 @@
+#ifndef _HUD_TEXT_H_
+#define _HUD_TEXT_H_
+
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Longer text is cut short.
+#define HUD_TEXT_SIZE 256
+
+// A line of HUD text, formatted and measured again only when what it shows
+// or how it is laid out changes, which for most of the HUD is seldom. The key
+// is the values, and the layout, that is the format and the font size. Each
+// line drawn keeps a HudText of its own between frames.
+typedef struct HudText
+{
+	bool valid;
+	char const *format;
+	int values[2];
+	float font_size;
+
+	char text[HUD_TEXT_SIZE];
+	float width;
+	float height;
+} HudText;
+
+// Format and measure calls made and saved, since last asked.
+typedef struct HudTextStats
+{
+	int formatted;
+	int measured;
+	int formats_saved;
+	int measures_saved;
+} HudTextStats;
+
+// Formats up to two ints, unused ones ignored.
+HudText const *hud_text_format(HudText *text, char const *format, int a, int b);
+
+// Text as it is, which only needs measuring when it changes.
+HudText const *hud_text_string(HudText *text, char const *string);
+
+// Returns the work done and saved since the last call, to be called once a
+// frame.
+void hud_text_stats(HudTextStats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ifndef _HUD_TEXT_H_
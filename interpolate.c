@@ -0,0 +1,70 @@
+#include <string.h>
+#include "interpolate.h"
+
+static int jumped(Scalar from, Scalar to)
+{
+	Scalar step = to > from ? to - from : from - to;
+
+	return step > scalar_from_int(INTERPOLATE_MAX_STEP);
+}
+
+static void interpolate_position(
+	Scalar from_x,
+	Scalar from_y,
+	Scalar *x,
+	Scalar *y,
+	double alpha)
+{
+	if (jumped(from_x, *x) || jumped(from_y, *y))
+	{
+		return;
+	}
+
+	*x = scalar_lerp(from_x, *x, alpha);
+	*y = scalar_lerp(from_y, *y, alpha);
+}
+
+void interpolate_game_state(
+	GameState const *from,
+	GameState const *to,
+	double alpha,
+	GameState *out)
+{
+	memcpy(out, to, to->size);
+
+	if (from->size != to->size || alpha >= 1)
+	{
+		return;
+	}
+
+	Ship const *from_ships = game_state_ships(from);
+	Ship *ships = game_state_ships(out);
+
+	for (int i = 0; i < out->num_ships; i++)
+	{
+		interpolate_position(
+			from_ships[i].position.x,
+			from_ships[i].position.y,
+			&ships[i].position.x,
+			&ships[i].position.y,
+			alpha);
+	}
+
+	Bullets from_bullets = game_state_bullets(from);
+	Bullets bullets = game_state_bullets(out);
+
+	// Bullets just fired have nowhere to come from.
+	for (int i = 0; i < bullets.capacity; i++)
+	{
+		if (bullet_is_active(&bullets, i) &&
+			bullet_is_active(&from_bullets, i))
+		{
+			interpolate_position(
+				from_bullets.x[i],
+				from_bullets.y[i],
+				bullets.x + i,
+				bullets.y + i,
+				alpha);
+		}
+	}
+}
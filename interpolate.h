@@ -0,0 +1,28 @@
+#ifndef _INTERPOLATE_H_
+#define _INTERPOLATE_H_
+
+#include "game_state.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Anything that moved further than this, in pixels along either axis,
+// between two frames jumped, like a bullet slot reused, and is drawn where
+// it ended up.
+#define INTERPOLATE_MAX_STEP 32
+
+// Copies to into out, with ships and bullets alpha of the way there from
+// where they were in from, so that drawing can run faster than the
+// simulation. Both states must be from the same session.
+void interpolate_game_state(
+	GameState const *from,
+	GameState const *to,
+	double alpha,
+	GameState *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ifndef _INTERPOLATE_H_
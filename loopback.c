@@ -0,0 +1,160 @@
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "loopback.h"
+
+typedef struct LoopbackPacket
+{
+	int from;
+	int to;
+	unsigned int deliver_ms;
+	int len;
+	unsigned char *data;
+} LoopbackPacket;
+
+int loopback_create(Loopback *loopback, int num_endpoints)
+{
+	if (num_endpoints < 1 || num_endpoints > LOOPBACK_MAX_ENDPOINTS)
+	{
+		return false;
+	}
+
+	memset(loopback, 0, sizeof(*loopback));
+	loopback->num_endpoints = num_endpoints;
+
+	for (int i = 0; i < num_endpoints; i++)
+	{
+		loopback->endpoints[i].loopback = loopback;
+		loopback->endpoints[i].index = i;
+	}
+
+	return true;
+}
+
+void loopback_destroy(Loopback *loopback)
+{
+	for (int i = 0; i < loopback->num_packets; i++)
+	{
+		free(loopback->packets[i].data);
+	}
+
+	free(loopback->packets);
+	memset(loopback, 0, sizeof(*loopback));
+}
+
+void loopback_set_delay(
+	Loopback *loopback, int from, int to, unsigned int delay_ms)
+{
+	loopback->delay_ms[from][to] = delay_ms;
+}
+
+void loopback_advance(Loopback *loopback, unsigned int ms)
+{
+	loopback->now_ms += ms;
+}
+
+static void loopback_send(void *context, int peer, void const *data, int len)
+{
+	LoopbackEndpoint *endpoint = (LoopbackEndpoint*)context;
+	Loopback *loopback = endpoint->loopback;
+
+	if (peer < 0 || peer >= loopback->num_endpoints)
+	{
+		return;
+	}
+
+	if (loopback->num_packets == loopback->capacity)
+	{
+		int capacity = loopback->capacity ? loopback->capacity * 2 : 64;
+		LoopbackPacket *packets = (LoopbackPacket*)realloc(
+			loopback->packets, capacity * sizeof(LoopbackPacket));
+
+		// Lost, as it could be on any network.
+		if (!packets)
+		{
+			return;
+		}
+
+		loopback->packets = packets;
+		loopback->capacity = capacity;
+	}
+
+	LoopbackPacket *packet = loopback->packets + loopback->num_packets;
+
+	packet->data = (unsigned char*)malloc(len);
+
+	if (!packet->data)
+	{
+		return;
+	}
+
+	memcpy(packet->data, data, len);
+	packet->from = endpoint->index;
+	packet->to = peer;
+	packet->len = len;
+	packet->deliver_ms =
+		loopback->now_ms + loopback->delay_ms[endpoint->index][peer];
+
+	loopback->num_packets++;
+	loopback->packets_sent++;
+	loopback->bytes_sent += len;
+}
+
+static int loopback_receive(
+	void *context, int *peer, void *data, int capacity)
+{
+	LoopbackEndpoint *endpoint = (LoopbackEndpoint*)context;
+	Loopback *loopback = endpoint->loopback;
+	int next = -1;
+
+	// Packets are kept in the order sent, so the first due is the oldest.
+	for (int i = 0; i < loopback->num_packets; i++)
+	{
+		LoopbackPacket const *packet = loopback->packets + i;
+
+		if (packet->to == endpoint->index &&
+			(int)(loopback->now_ms - packet->deliver_ms) >= 0)
+		{
+			next = i;
+			break;
+		}
+	}
+
+	if (next < 0)
+	{
+		return 0;
+	}
+
+	LoopbackPacket packet = loopback->packets[next];
+
+	memmove(loopback->packets + next,
+		loopback->packets + next + 1,
+		(loopback->num_packets - next - 1) * sizeof(LoopbackPacket));
+
+	loopback->num_packets--;
+
+	int len = packet.len < capacity ? packet.len : capacity;
+
+	memcpy(data, packet.data, len);
+	free(packet.data);
+	*peer = packet.from;
+
+	return len;
+}
+
+static unsigned int loopback_now_ms(void *context)
+{
+	return ((LoopbackEndpoint*)context)->loopback->now_ms;
+}
+
+RollbackTransport loopback_transport(Loopback *loopback, int endpoint)
+{
+	RollbackTransport transport;
+
+	transport.context = loopback->endpoints + endpoint;
+	transport.send = loopback_send;
+	transport.receive = loopback_receive;
+	transport.now_ms = loopback_now_ms;
+
+	return transport;
+}
@@ -0,0 +1,55 @@
+#ifndef _LOOPBACK_H_
+#define _LOOPBACK_H_
+
+#include "rollback.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define LOOPBACK_MAX_ENDPOINTS ROLLBACK_MAX_PLAYERS
+
+struct LoopbackPacket;
+
+typedef struct LoopbackEndpoint
+{
+	struct Loopback *loopback;
+	int index;
+} LoopbackEndpoint;
+
+// An in-memory network between endpoints in the same process, on a clock
+// that only moves when told to. Each endpoint gets a RollbackTransport in
+// which peer n is endpoint n. A datagram arrives once the delay set for its
+// link has passed, and nothing is lost.
+typedef struct Loopback
+{
+	int num_endpoints;
+	unsigned int now_ms;
+	unsigned int delay_ms[LOOPBACK_MAX_ENDPOINTS][LOOPBACK_MAX_ENDPOINTS];
+	LoopbackEndpoint endpoints[LOOPBACK_MAX_ENDPOINTS];
+	struct LoopbackPacket *packets;
+	int num_packets;
+	int capacity;
+	long long packets_sent;
+	long long bytes_sent;
+} Loopback;
+
+int loopback_create(Loopback *loopback, int num_endpoints);
+
+void loopback_destroy(Loopback *loopback);
+
+void loopback_set_delay(
+	Loopback *loopback,
+	int from,
+	int to,
+	unsigned int delay_ms);
+
+void loopback_advance(Loopback *loopback, unsigned int ms);
+
+RollbackTransport loopback_transport(Loopback *loopback, int endpoint);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ifndef _LOOPBACK_H_
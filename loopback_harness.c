@@ -0,0 +1,822 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "checksum.h"
+#include "game.h"
+#include "game_state.h"
+#include "loopback.h"
+#include "netsim.h"
+#include "predictors.h"
+#include "rollback.h"
+#include "state_hash.h"
+#include "timer.h"
+
+// Runs several rollback sessions in one process, one per player, connected
+// through a Loopback network, and checks that every peer arrives at the same
+// game state hash for every frame once its inputs are confirmed everywhere.
+// The game is a single instance, so each peer's state is swapped in before it
+// runs and swapped out after. Inputs are drawn from a seeded generator per
+// peer, so the hashes don't depend on latency or scheduling. A Netsim between
+// each session and the network makes it a bad one, reproducibly by seed.
+
+#define ARENA_WIDTH  640
+#define ARENA_HEIGHT 480
+
+#define NUM_BUTTONS  6
+
+// Hashes kept per peer, well past how far ahead of the confirmed frame a peer
+// can get. Must be a power of two.
+#define HASH_FRAMES  64
+
+typedef struct HarnessOptions
+{
+	int num_players;
+	int frames;
+	int max_bullets;
+	int frame_delay;
+	int min_frame_delay;
+	int max_frame_delay;
+	unsigned int latency_ms;
+	unsigned int stagger_ms;
+	unsigned int seed;
+	char const *netsim;
+	unsigned int netsim_seed;
+	char const *export_prefix;
+	char const *predictor;
+	enum CHECKSUM checksum;
+	NetsimLink link;
+} HarnessOptions;
+
+// Each button is held, then released, for a random number of frames in
+// ranges typical of it.
+typedef struct InputScript
+{
+	unsigned int random;
+	int input;
+	int frames_left[NUM_BUTTONS];
+} InputScript;
+
+typedef struct Peer
+{
+	RollbackSession *session;
+	GGPOPlayerHandle local_player;
+	Netsim netsim;
+	unsigned char *state;
+	InputScript script;
+	HoldPredictor hold;
+	LearnedPredictor learned;
+	// Frame times are start_ms + frames * 1000 / 60.
+	unsigned int start_ms;
+	int frames;
+	int stalls;
+	int hashes[HASH_FRAMES];
+} Peer;
+
+static Peer *peers;
+static Peer *current;
+static int state_size;
+static long long swap_ticks;
+static long long *frame_ticks;
+static int num_frame_ticks;
+static enum CHECKSUM checksum_kind;
+static int checksum_mismatches;
+static int failed_rollbacks;
+
+// xorshift32.
+static unsigned int next_random(unsigned int *state)
+{
+	unsigned int x = *state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	return *state = x;
+}
+
+static bool __cdecl harness_begin_game(const char *game)
+{
+	return begin_game(game);
+}
+
+// Taken afresh over a saved state, so that it doesn't share the game's
+// incremental bookkeeping.
+static int reference_checksum(unsigned char const *buffer, int len)
+{
+	StateHash hash;
+
+	if (checksum_kind != CHECKSUM_fletcher32)
+	{
+		return compute_checksum(checksum_kind, buffer, len);
+	}
+
+	if (!state_hash_create(&hash, len))
+	{
+		return -1;
+	}
+
+	int value = state_hash_value(&hash, buffer);
+	state_hash_destroy(&hash);
+
+	return value;
+}
+
+static bool __cdecl harness_save_game_state(
+	unsigned char **buffer, int *len, int *checksum, int frame)
+{
+	if (!save_game_state(buffer, len, checksum, frame))
+	{
+		return false;
+	}
+
+	// What GGPO compares must be what the HUD shows, and the checksum picked.
+	int hash = game_state_hash();
+	int reference = reference_checksum(*buffer, *len);
+
+	if ((*checksum != hash || *checksum != reference) &&
+		!checksum_mismatches++)
+	{
+		fprintf(stderr,
+			"Frame %d saved with checksum %08x, hashes to %08x, "
+			"should be %08x.\n",
+			frame,
+			*checksum,
+			hash,
+			reference);
+	}
+
+	return true;
+}
+
+static bool __cdecl harness_load_game_state(unsigned char *buffer, int len)
+{
+	return load_game_state(buffer, len);
+}
+
+static bool __cdecl harness_log_game_state(
+	char *filename, unsigned char *buffer, int len)
+{
+	return log_game_state(filename, buffer, len);
+}
+
+static void __cdecl harness_free_buffer(void *buffer)
+{
+	free_game_state(buffer);
+}
+
+static bool __cdecl harness_advance_frame(int flags)
+{
+	(void)flags;
+
+	LocalInput inputs[ROLLBACK_MAX_PLAYERS];
+	int disconnect_flags;
+
+	if (!GGPO_SUCCEEDED(rollback_synchronize_input(
+		current->session, inputs, sizeof(inputs), &disconnect_flags)))
+	{
+		return false;
+	}
+
+	step_game(inputs, disconnect_flags);
+	rollback_advance_frame(current->session);
+
+	current->hashes[game_frame_number() & (HASH_FRAMES - 1)] =
+		game_state_hash();
+
+	return true;
+}
+
+static bool __cdecl harness_on_event(GGPOEvent *event)
+{
+	(void)event;
+
+	return true;
+}
+
+static void swap_in(Peer *peer)
+{
+	long long start = timer_ticks();
+	load_game_state(peer->state, state_size);
+	swap_ticks += timer_ticks() - start;
+	current = peer;
+}
+
+static void swap_out(Peer *peer)
+{
+	long long start = timer_ticks();
+	memcpy(peer->state, game_state(), state_size);
+	swap_ticks += timer_ticks() - start;
+}
+
+static int next_input(InputScript *script)
+{
+	// Frames held, from and to, then frames released, from and to, for
+	// thrust, brake, rotating left and right, fire and bomb.
+	static const int spans[NUM_BUTTONS][4] =
+	{
+		{ 10, 60, 5, 40 },
+		{ 3, 15, 60, 240 },
+		{ 3, 20, 10, 60 },
+		{ 3, 20, 10, 60 },
+		{ 1, 3, 4, 12 },
+		{ 1, 2, 120, 600 },
+	};
+
+	for (int b = 0; b < NUM_BUTTONS; b++)
+	{
+		if (script->frames_left[b]-- > 0)
+		{
+			continue;
+		}
+
+		script->input ^= 1 << b;
+
+		int const *span = spans[b] + (script->input >> b & 1 ? 0 : 2);
+		script->frames_left[b] = span[0] +
+			(int)(next_random(&script->random) % (span[1] - span[0] + 1));
+	}
+
+	return script->input;
+}
+
+static int compare_ticks(void const *lhs, void const *rhs)
+{
+	long long l = *(long long const*)lhs;
+	long long r = *(long long const*)rhs;
+	return (l > r) - (l < r);
+}
+
+static double percentile(double p)
+{
+	int i = (int)(p * (num_frame_ticks - 1) + 0.5);
+	return timer_ticks_to_ns(frame_ticks[i]);
+}
+
+static void run_frame(Peer *peer)
+{
+	swap_in(peer);
+
+	long long start = timer_ticks();
+
+	if (!GGPO_SUCCEEDED(rollback_idle(peer->session)) && !failed_rollbacks++)
+	{
+		fprintf(stderr, "Player %d couldn't roll back.\n", peer->local_player);
+	}
+
+	InputScript script = peer->script;
+	LocalInput input = { next_input(&peer->script) };
+
+	if (GGPO_SUCCEEDED(rollback_add_local_input(
+		peer->session, peer->local_player, &input, sizeof(input))))
+	{
+		harness_advance_frame(0);
+	}
+	else
+	{
+		// Drawn again on the next try, so that a peer's inputs don't depend
+		// on when it stalled.
+		peer->script = script;
+		peer->stalls++;
+	}
+
+	frame_ticks[num_frame_ticks++] = timer_ticks() - start;
+
+	swap_out(peer);
+	peer->frames++;
+}
+
+static void show_syntax()
+{
+	fprintf(stderr,
+		"Syntax: loopback_harness [--players n] [--frames n] [--bullets n]\n"
+		"                         [--frame-delay n] [--latency ms]\n"
+		"                         [--stagger ms] [--seed n]\n"
+		"                         [--netsim settings] [--netsim-seed n]\n"
+		"                         [--export prefix]\n"
+		"                         [--predictor repeat|hold|learned]\n"
+		"                         [--adaptive-delay min-max]\n"
+		"                         [--checksum fletcher32|stripe]\n"
+		"Netsim settings are comma separated, out of latency=ms, jitter=ms,\n"
+		"distribution=uniform|normal|pareto, loss=rate, burst=datagrams,\n"
+		"duplicate=rate and reorder=rate.\n");
+}
+
+static int parse_args(int argc, char *args[], HarnessOptions *options)
+{
+	options->num_players = 2;
+	options->frames = 20000;
+	options->max_bullets = DEFAULT_MAX_BULLETS;
+	options->frame_delay = 2;
+	options->min_frame_delay = -1;
+	options->max_frame_delay = -1;
+	options->latency_ms = 0;
+	options->stagger_ms = 0;
+	options->seed = 1;
+	options->netsim = NULL;
+	options->netsim_seed = 0;
+	options->export_prefix = NULL;
+	options->predictor = "repeat";
+	options->checksum = CHECKSUM_fletcher32;
+
+	for (int i = 1; i + 1 < argc; i += 2)
+	{
+		char const *value = args[i + 1];
+
+		if (!strcmp(args[i], "--players"))
+		{
+			options->num_players = atoi(value);
+		}
+		else if (!strcmp(args[i], "--frames"))
+		{
+			options->frames = atoi(value);
+		}
+		else if (!strcmp(args[i], "--bullets"))
+		{
+			options->max_bullets = atoi(value);
+		}
+		else if (!strcmp(args[i], "--frame-delay"))
+		{
+			options->frame_delay = atoi(value);
+		}
+		else if (!strcmp(args[i], "--latency"))
+		{
+			options->latency_ms = (unsigned int)strtoul(value, NULL, 10);
+		}
+		else if (!strcmp(args[i], "--stagger"))
+		{
+			options->stagger_ms = (unsigned int)strtoul(value, NULL, 10);
+		}
+		else if (!strcmp(args[i], "--seed"))
+		{
+			options->seed = (unsigned int)strtoul(value, NULL, 10);
+		}
+		else if (!strcmp(args[i], "--netsim"))
+		{
+			options->netsim = value;
+
+			if (!netsim_parse_link(value, &options->link))
+			{
+				return false;
+			}
+		}
+		else if (!strcmp(args[i], "--netsim-seed"))
+		{
+			options->netsim_seed = (unsigned int)strtoul(value, NULL, 10);
+		}
+		else if (!strcmp(args[i], "--export"))
+		{
+			options->export_prefix = value;
+		}
+		else if (!strcmp(args[i], "--predictor"))
+		{
+			options->predictor = value;
+		}
+		else if (!strcmp(args[i], "--checksum"))
+		{
+			if (!strcmp(value, "fletcher32"))
+			{
+				options->checksum = CHECKSUM_fletcher32;
+			}
+			else if (!strcmp(value, "stripe"))
+			{
+				options->checksum = CHECKSUM_stripe;
+			}
+			else
+			{
+				return false;
+			}
+		}
+		else if (!strcmp(args[i], "--adaptive-delay"))
+		{
+			if (sscanf(value,
+					"%d-%d",
+					&options->min_frame_delay,
+					&options->max_frame_delay) != 2 ||
+				options->min_frame_delay < 0 ||
+				options->min_frame_delay > options->max_frame_delay)
+			{
+				return false;
+			}
+		}
+		else
+		{
+			return false;
+		}
+	}
+
+	return argc % 2 == 1 &&
+		(!strcmp(options->predictor, "repeat") ||
+			!strcmp(options->predictor, "hold") ||
+			!strcmp(options->predictor, "learned")) &&
+		options->num_players > 0 &&
+		options->num_players <= ROLLBACK_MAX_PLAYERS &&
+		options->frames > 0 &&
+		options->max_bullets > 0 &&
+		options->frame_delay >= 0 &&
+		options->seed != 0;
+}
+
+static int start_sessions(HarnessOptions *options, Loopback *loopback)
+{
+	GGPOSessionCallbacks callbacks;
+
+	callbacks.begin_game = harness_begin_game;
+	callbacks.save_game_state = harness_save_game_state;
+	callbacks.load_game_state = harness_load_game_state;
+	callbacks.log_game_state = harness_log_game_state;
+	callbacks.free_buffer = harness_free_buffer;
+	callbacks.advance_frame = harness_advance_frame;
+	callbacks.on_event = harness_on_event;
+
+	for (int i = 0; i < options->num_players; i++)
+	{
+		Peer *peer = peers + i;
+		RollbackTransport transport = loopback_transport(loopback, i);
+
+		if (options->netsim)
+		{
+			// Every peer draws from its own generator, all from one seed.
+			netsim_create(&peer->netsim,
+				&transport,
+				i ? options->netsim_seed + i : options->netsim_seed);
+			netsim_set_link(&peer->netsim, -1, &options->link);
+
+			options->netsim_seed = peers[0].netsim.seed;
+			transport = netsim_transport(&peer->netsim);
+		}
+
+		peer->state = (unsigned char*)malloc(state_size);
+		peer->script.random = options->seed + i * 0x9e3779b9u;
+		peer->start_ms = i * options->stagger_ms;
+
+		if (!peer->state)
+		{
+			return false;
+		}
+
+		memcpy(peer->state, game_state(), state_size);
+
+		if (!GGPO_SUCCEEDED(rollback_start_session(&peer->session,
+			&callbacks,
+			&transport,
+			options->num_players,
+			sizeof(LocalInput))))
+		{
+			return false;
+		}
+
+		// However bad the network, wait rather than go on without a peer,
+		// after which the hashes would no longer agree.
+		rollback_set_disconnect_timeout(peer->session, 0);
+		rollback_set_disconnect_notify_start(peer->session, 0);
+
+		for (int j = 0; j < options->num_players; j++)
+		{
+			GGPOPlayer player;
+			GGPOPlayerHandle handle;
+
+			memset(&player, 0, sizeof(player));
+			player.size = sizeof(player);
+			player.player_num = j + 1;
+			player.type = i == j
+				? GGPO_PLAYERTYPE_LOCAL
+				: GGPO_PLAYERTYPE_REMOTE;
+
+			rollback_add_player(peer->session, &player, j, &handle);
+
+			if (i == j)
+			{
+				peer->local_player = handle;
+				rollback_set_frame_delay(
+					peer->session, handle, options->frame_delay);
+
+				if (options->max_frame_delay >= 0 &&
+					rollback_set_adaptive_frame_delay(peer->session,
+						handle,
+						options->min_frame_delay,
+						options->max_frame_delay) != GGPO_OK)
+				{
+					return false;
+				}
+			}
+			else
+			{
+				loopback_set_delay(loopback, i, j, options->latency_ms);
+			}
+		}
+
+		// All of them guess, the one picked is used.
+		RollbackPredictor predictors[2];
+		int index;
+
+		if (!hold_predictor_create(
+				&peer->hold, options->num_players, sizeof(LocalInput)) ||
+			!learned_predictor_create(
+				&peer->learned, options->num_players, sizeof(LocalInput)))
+		{
+			return false;
+		}
+
+		predictors[0] = hold_predictor_interface(&peer->hold);
+		predictors[1] = learned_predictor_interface(&peer->learned);
+
+		if (!strcmp(options->predictor, "repeat"))
+		{
+			rollback_use_predictor(peer->session, 0);
+		}
+
+		for (int k = 0; k < 2; k++)
+		{
+			rollback_add_predictor(peer->session, predictors + k, &index);
+
+			if (!strcmp(options->predictor, predictors[k].name))
+			{
+				rollback_use_predictor(peer->session, index);
+			}
+		}
+	}
+
+	return true;
+}
+
+// The next frame whose hash every peer has final.
+static int check_hashes(int num_players, int frame)
+{
+	int confirmed = 0x7fffffff;
+
+	for (int i = 0; i < num_players; i++)
+	{
+		int last = rollback_confirmed_frame(peers[i].session) + 1;
+		int simulated = rollback_frame_number(peers[i].session);
+
+		last = simulated < last ? simulated : last;
+		confirmed = last < confirmed ? last : confirmed;
+	}
+
+	for (; frame <= confirmed; frame++)
+	{
+		int hash = peers[0].hashes[frame & (HASH_FRAMES - 1)];
+
+		for (int i = 1; i < num_players; i++)
+		{
+			if (peers[i].hashes[frame & (HASH_FRAMES - 1)] != hash)
+			{
+				fprintf(stderr,
+					"Frame %d: peer 1 hashes %08x, peer %d %08x.\n",
+					frame,
+					hash,
+					i + 1,
+					peers[i].hashes[frame & (HASH_FRAMES - 1)]);
+
+				return -1;
+			}
+		}
+	}
+
+	return frame;
+}
+
+int main(int argc, char *args[])
+{
+	HarnessOptions options;
+	Loopback loopback;
+
+	if (!parse_args(argc, args, &options))
+	{
+		show_syntax();
+		return 1;
+	}
+
+	peers = (Peer*)calloc(options.num_players, sizeof(Peer));
+	frame_ticks = (long long*)malloc(
+		(size_t)options.num_players * options.frames * sizeof(long long));
+
+	if (!peers ||
+		!frame_ticks ||
+		!setup_game(ARENA_WIDTH,
+			ARENA_HEIGHT,
+			options.num_players,
+			options.max_bullets) ||
+		!loopback_create(&loopback, options.num_players))
+	{
+		fprintf(stderr, "Out of memory.\n");
+		return 1;
+	}
+
+	state_size = game_state()->size;
+	checksum_kind = options.checksum;
+	game_set_checksum(options.checksum);
+
+	if (!start_sessions(&options, &loopback))
+	{
+		fprintf(stderr, "Can't start the sessions.\n");
+		return 1;
+	}
+
+	int checked = 1;
+	long long start = timer_ticks();
+
+	// Every peer runs a frame when its clock says so, until the last has run
+	// all of its frames.
+	for (;;)
+	{
+		Peer *next = NULL;
+		unsigned int next_ms = 0;
+
+		for (int i = 0; i < options.num_players; i++)
+		{
+			Peer *peer = peers + i;
+			unsigned int due =
+				peer->start_ms + (unsigned int)(peer->frames * 1000LL / 60);
+
+			if (peer->frames < options.frames && (!next || due < next_ms))
+			{
+				next = peer;
+				next_ms = due;
+			}
+		}
+
+		if (!next)
+		{
+			break;
+		}
+
+		loopback_advance(&loopback, next_ms - loopback.now_ms);
+		run_frame(next);
+
+		checked = check_hashes(options.num_players, checked);
+
+		if (checked < 0 || checksum_mismatches || failed_rollbacks)
+		{
+			return 1;
+		}
+	}
+
+	double elapsed = timer_ticks_to_ns(timer_ticks() - start) / 1e9;
+	long long simulated = 0;
+	long long resimulated = 0;
+	int result = 0;
+
+	printf("players:    %d, %u ms apart, %d frames delay\n",
+		options.num_players, options.latency_ms, options.frame_delay);
+	printf("state:      %d bytes\n", state_size);
+
+	if (options.netsim)
+	{
+		NetsimStats total = { 0 };
+
+		for (int i = 0; i < options.num_players; i++)
+		{
+			total.sent += peers[i].netsim.stats.sent;
+			total.dropped += peers[i].netsim.stats.dropped;
+			total.duplicated += peers[i].netsim.stats.duplicated;
+			total.reordered += peers[i].netsim.stats.reordered;
+		}
+
+		printf("netsim:     %s --netsim-seed %u\n",
+			options.netsim, options.netsim_seed);
+		printf("            %lld sent, %lld dropped, %lld duplicated, "
+			"%lld reordered\n",
+			total.sent, total.dropped, total.duplicated, total.reordered);
+	}
+
+	for (int i = 0; i < options.num_players; i++)
+	{
+		RollbackStats stats;
+		rollback_get_stats(peers[i].session, &stats);
+
+		printf("peer %-2d     frame %d, %d stalls, %lld rollbacks, "
+			"%lld frames resimulated, %d deepest\n",
+			i + 1,
+			rollback_frame_number(peers[i].session),
+			peers[i].stalls,
+			stats.rollbacks,
+			stats.frames_resimulated,
+			stats.max_rollback_depth);
+
+		printf("            rollbacks by depth:");
+
+		for (int d = 1; d < ROLLBACK_DEPTH_BUCKETS; d++)
+		{
+			printf(" %lld", stats.depth_histogram[d]);
+		}
+
+		printf("\n            mispredicted:");
+
+		for (int j = 0; j < options.num_players; j++)
+		{
+			RollbackPlayerStats const *player = stats.players + j;
+
+			if (j != i)
+			{
+				printf(" %.1f%% of %d's",
+					player->predictions
+						? player->mispredictions * 100.0 / player->predictions
+						: 0,
+					j + 1);
+			}
+		}
+
+		printf("\n            would have mispredicted:");
+
+		for (int k = 0; k < stats.num_predictors; k++)
+		{
+			RollbackPredictorStats const *predictor = stats.predictors + k;
+
+			printf(" %.1f%% %s",
+				predictor->predictions
+					? predictor->mispredictions * 100.0 /
+						predictor->predictions
+					: 0,
+				predictor->name);
+		}
+
+		printf("\n            input delay %d, proposing %d, "
+			"%lld changes, last at frame %d, %lld inputs dropped",
+			stats.frame_delay,
+			stats.proposed_delay,
+			stats.delay_changes,
+			stats.last_delay_change,
+			stats.inputs_dropped);
+
+		printf("\n            replaying %.0f ns stepping, %.0f ns saving, "
+			"%.0f ns loading per rollback\n",
+			stats.rollbacks
+				? timer_ticks_to_ns(stats.resimulate_ticks -
+					stats.resimulate_save_ticks) / stats.rollbacks
+				: 0,
+			stats.rollbacks
+				? timer_ticks_to_ns(stats.resimulate_save_ticks) /
+					stats.rollbacks
+				: 0,
+			stats.rollbacks
+				? timer_ticks_to_ns(stats.load_ticks) / stats.rollbacks
+				: 0);
+
+		if (options.export_prefix)
+		{
+			char filename[512];
+
+			snprintf(filename,
+				sizeof(filename),
+				"%s%d.csv",
+				options.export_prefix,
+				i + 1);
+
+			if (!rollback_export_stats(&stats, filename))
+			{
+				fprintf(stderr, "Can't write %s.\n", filename);
+			}
+		}
+
+		simulated += stats.frames + stats.frames_resimulated;
+		resimulated += stats.frames_resimulated;
+
+		// The delay reported must be the one inputs are sent with.
+		if (stats.input_lead != stats.frame_delay)
+		{
+			fprintf(stderr, "Peer %d sends inputs %d frames ahead, "
+				"with a delay of %d.\n",
+				i + 1,
+				stats.input_lead,
+				stats.frame_delay);
+			result = 1;
+		}
+	}
+
+	printf("seconds:    %.3f, %.1f%% swapping peers\n",
+		elapsed, timer_ticks_to_ns(swap_ticks) / 1e7 / elapsed);
+	printf("frames/sec: %.0f simulated, %.1f%% again\n",
+		simulated / elapsed, simulated ? resimulated * 100.0 / simulated : 0);
+	qsort(frame_ticks, num_frame_ticks, sizeof(long long), compare_ticks);
+
+	printf("frame ns:   p50 %.0f, p99 %.0f, p999 %.0f, max %.0f\n",
+		percentile(0.5),
+		percentile(0.99),
+		percentile(0.999),
+		percentile(1.0));
+	printf("packets:    %lld, %lld bytes\n",
+		loopback.packets_sent, loopback.bytes_sent);
+	printf("hash:       %08x, agreed through frame %d\n",
+		peers[0].hashes[(checked - 1) & (HASH_FRAMES - 1)], checked - 1);
+
+	for (int i = 0; i < options.num_players; i++)
+	{
+		rollback_close_session(peers[i].session);
+		free(peers[i].state);
+
+		if (options.netsim)
+		{
+			netsim_destroy(&peers[i].netsim);
+		}
+
+		hold_predictor_destroy(&peers[i].hold);
+		learned_predictor_destroy(&peers[i].learned);
+	}
+
+	loopback_destroy(&loopback);
+	tear_down_game();
+	free(peers);
+	free(frame_ticks);
+
+	return result;
+}
@@ -7,9 +7,21 @@
 #include <string.h>
 #include <windows.h>
 #include <gl/GL.h>
+#include "checksum.h"
 #include "connection_report.h"
 #include "game.h"
+#include "game_state.h"
+#include "hud_text.h"
+#include "interpolate.h"
+#include "pacer.h"
+#include "renderer.h"
+#include "timesync.h"
+#include "triple_buffer.h"
 #include "utils.h"
+#ifdef VECTORWAR_INTREE_ROLLBACK
+#include "ggpo_rollback.h"
+#include "timer.h"
+#endif
 
 #define MAX_GRAPH_SIZE 4096
 #define MAX_FAIRNESS 20
@@ -24,6 +36,10 @@ typedef struct ClientInit
 {
 	unsigned short local_port;
 	int num_players;
+	int max_bullets;
+	CHECKSUM checksum;
+	int keyframes;
+	const char *predictor;
 	ROLE_TYPE type;
 	union
 	{
@@ -69,12 +85,56 @@ typedef struct SdlHandles
 	SDL_Renderer* renderer;
 } SdlHandles;
 
+// What the simulation thread hands the render thread after every tick, in a
+// triple buffer, followed by the game state before the tick and after it,
+// each state_stride long.
+typedef struct SimFrame
+{
+	ConnectionReport connection_report;
+	FrameReport frame_report;
+	long long published;
+	// The pacer's counter when the tick ran.
+	unsigned long long tick;
+	int state_stride;
+	// Only while the performance monitor is shown.
+	bool has_stats;
+	int num_remotes;
+	GGPOPlayerHandle remotes[GGPO_MAX_PLAYERS];
+	GGPONetworkStats network[GGPO_MAX_PLAYERS];
+	PacerStats pacer;
+	TimeSync timesync;
+	SnapshotStats snapshot;
+#ifdef VECTORWAR_INTREE_ROLLBACK
+	RollbackStats rollback;
+#endif
+} SimFrame;
+
+#define SIM_FRAME_HEADER_SIZE ((sizeof(SimFrame) + 7) & ~(size_t)7)
+
+// 0 for the state before the tick, 1 for the one after.
+static GameState const *sim_frame_state(SimFrame const *frame, int which)
+{
+	return (GameState const*)((unsigned char const*)frame +
+		SIM_FRAME_HEADER_SIZE +
+		which * frame->state_stride);
+}
+
 typedef struct ClientState
 {
 	bool quit;
 	bool show_performance_monitor;
+	bool no_interpolation;
+	enum RENDERER_BACKEND backend;
 } ClientState;
 
+// What submitting the last frame took on the render thread, up to the swap.
+typedef struct SubmitCost
+{
+	// Smoothed.
+	double cpu_ms;
+	int imgui_commands;
+} SubmitCost;
+
 static ConnectionReport connection_report;
 
 static GgpoHandles ggpo;
@@ -84,6 +144,22 @@ static GGPOPlayerHandle participants[MAX_PARTICIPANTS];
 
 static FrameReport frame_report;
 
+static TimeSync timesync;
+
+static Pacer pacer;
+
+// The simulation thread owns everything above. The render thread only sees
+// what it publishes, and reaches back through these.
+static TripleBuffer sim_frames;
+static SubmitCost submit_cost;
+static unsigned char *last_published_state;
+static GameState *interpolated_state;
+static SDL_atomic_t sim_quit;
+static SDL_atomic_t sim_wants_stats;
+static SDL_atomic_t shared_input;
+// A player to disconnect, plus one, or 0.
+static SDL_atomic_t disconnect_request;
+
 static void set_connection_state(GGPOPlayerHandle handle, CONNECTION_STATE state)
 {
 	for (int i = 0; i < connection_report.num_participants; i++)
@@ -163,7 +239,19 @@ static bool __cdecl on_event(GGPOEvent *info)
 		break;
 
 	case GGPO_EVENTCODE_TIMESYNC:
-		SDL_Delay(1000 * info->u.timesync.frames_ahead / 60);
+		if (timesync.pending_ms > 0)
+		{
+			SDL_Log("Time sync: replaced after %.1f ms, %.1f ms short",
+				timesync.applied_ms,
+				timesync.pending_ms);
+		}
+
+		timesync_request(
+			&timesync, info->u.timesync.frames_ahead, 1000.0 / pacer.hz);
+
+		SDL_Log("Time sync: %d frames ahead, slowing down by %.1f ms",
+			info->u.timesync.frames_ahead,
+			timesync.pending_ms);
 		break;
 	}
 
@@ -177,45 +265,199 @@ static void setup_imgui_frame(SdlHandles handles)
 	ImGui::NewFrame();
 }
 
-void draw_centered_text(SdlHandles handles, char const *str, int y)
+void draw_centered_text(SdlHandles handles, HudText const *text, int y)
 {
 	int w, h;
 	SDL_GetWindowSize(handles.window, &w, &h);
 
 	ImGui::GetBackgroundDrawList()->AddText(
-		ImVec2(w / 2 - ImGui::CalcTextSize(str).x / 2, (float)y),
+		ImVec2(w / 2 - text->width / 2, (float)y),
 		IM_COL32_WHITE,
-		str);
+		text->text);
 }
 
-void draw_checksum(SdlHandles handles, FrameInfo frame_info, int y)
+void draw_checksum(
+	SdlHandles handles, HudText *text, FrameInfo frame_info, int y)
 {
-	char checksum[128];
+	draw_centered_text(
+		handles,
+		hud_text_format(
+			text,
+			"Frame: %04d Checksum: %08x",
+			frame_info.number,
+			frame_info.hash),
+		y);
+}
 
-	sprintf_s(
-		checksum,
-		COUNT_OF(checksum), 
-		"Frame: %04d Checksum: %08x", 
-		frame_info.number,
-		frame_info.hash);
+#ifdef VECTORWAR_INTREE_ROLLBACK
+static void plot_histogram(long long const *buckets, int count)
+{
+	float values[ROLLBACK_COST_BUCKETS > ROLLBACK_DEPTH_BUCKETS
+		? ROLLBACK_COST_BUCKETS
+		: ROLLBACK_DEPTH_BUCKETS];
+	float max = 1;
+
+	for (int i = 0; i < count; i++)
+	{
+		values[i] = (float)buckets[i];
+		max = values[i] > max ? values[i] : max;
+	}
 
-	draw_centered_text(handles, checksum, y);
+	ImGui::PlotHistogram(
+		"",
+		values,
+		count,
+		0,
+		NULL,
+		0,
+		max,
+		ImVec2(512, 80));
 }
 
-void draw_performance_monitor(ClientState *cs)
+static void draw_rollback_stats(
+	RollbackStats const *stats,
+	GGPOPlayerHandle const *remotes,
+	int num_remotes)
 {
-	GGPOPlayerHandle remotes[MAX_PLAYERS];
+	ImGui::Separator();
+	ImGui::Text("Rollback");
 
-	int num_remotes = 0;
-	for (int i = 0; i < connection_report.num_participants; i++)
+	char rollbacks[128], frames_resimulated[128];
+
+	sprintf_s(rollbacks, COUNT_OF(rollbacks), "%lld", stats->rollbacks);
+
+	sprintf_s(
+		frames_resimulated,
+		COUNT_OF(frames_resimulated),
+		"%lld (%.1f%%)",
+		stats->frames_resimulated,
+		stats->frames ? stats->frames_resimulated * 100.0 / stats->frames : 0);
+
+	ImGui::Columns(4, "", false);
+	ImGui::Text("Rollbacks:"); ImGui::NextColumn();
+	ImGui::Text(rollbacks); ImGui::NextColumn();
+	ImGui::Text("Replayed:"); ImGui::NextColumn();
+	ImGui::Text(frames_resimulated); ImGui::NextColumn();
+	ImGui::Columns(1);
+
+	char frame_delay[128], delay_changes[128];
+
+	sprintf_s(
+		frame_delay,
+		COUNT_OF(frame_delay),
+		"%d (proposing %d)",
+		stats->frame_delay,
+		stats->proposed_delay);
+
+	sprintf_s(
+		delay_changes,
+		COUNT_OF(delay_changes),
+		"%lld, last at frame %d",
+		stats->delay_changes,
+		stats->last_delay_change);
+
+	ImGui::Columns(4, "", false);
+	ImGui::Text("Input delay:"); ImGui::NextColumn();
+	ImGui::Text(frame_delay); ImGui::NextColumn();
+	ImGui::Text("Changed:"); ImGui::NextColumn();
+	ImGui::Text(delay_changes); ImGui::NextColumn();
+	ImGui::Columns(1);
+
+	// Per rollback, in microseconds.
+	double per_rollback = stats->rollbacks ? 1e-3 / stats->rollbacks : 0;
+	char load[128], save[128], step[128];
+
+	sprintf_s(load, COUNT_OF(load), "%.1f us",
+		timer_ticks_to_ns(stats->load_ticks) * per_rollback);
+
+	sprintf_s(save, COUNT_OF(save), "%.1f us",
+		timer_ticks_to_ns(stats->resimulate_save_ticks) * per_rollback);
+
+	sprintf_s(step, COUNT_OF(step), "%.1f us",
+		timer_ticks_to_ns(
+			stats->resimulate_ticks - stats->resimulate_save_ticks) *
+				per_rollback);
+
+	ImGui::Columns(4, "", false);
+	ImGui::Text("Load:"); ImGui::NextColumn();
+	ImGui::Text(load); ImGui::NextColumn();
+	ImGui::Text("Save:"); ImGui::NextColumn();
+	ImGui::Text(save); ImGui::NextColumn();
+	ImGui::Text("Step:"); ImGui::NextColumn();
+	ImGui::Text(step); ImGui::NextColumn();
+	ImGui::Columns(1);
+
+	ImGui::Text("Depth, 1 to %d+ frames", ROLLBACK_DEPTH_BUCKETS - 1);
+	plot_histogram(stats->depth_histogram + 1, ROLLBACK_DEPTH_BUCKETS - 1);
+
+	ImGui::Text(
+		"Cost, under 1 us to over %d us",
+		1 << (ROLLBACK_COST_BUCKETS - 2));
+	plot_histogram(stats->cost_histogram, ROLLBACK_COST_BUCKETS);
+
+	for (int j = 0; j < num_remotes; j++)
 	{
-		if (connection_report.participants[i].type == PARTICIPANT_TYPE_remote)
-		{
-			remotes[num_remotes] = participants[i];
-			num_remotes++;
-		}
+		RollbackPlayerStats const *player = stats->players + remotes[j] - 1;
+		char remote_label[128], mispredicted[128];
+
+		sprintf_s(remote_label, COUNT_OF(remote_label), "Remote %d:", j);
+
+		sprintf_s(
+			mispredicted,
+			COUNT_OF(mispredicted),
+			"%.1f%% mispredicted",
+			player->predictions
+				? player->mispredictions * 100.0 / player->predictions
+				: 0);
+
+		ImGui::Columns(4, "", false);
+		ImGui::Text(remote_label); ImGui::NextColumn();
+		ImGui::Text(mispredicted); ImGui::NextColumn();
+		ImGui::Columns(1);
+	}
+
+	for (int k = 0; k < stats->num_predictors; k++)
+	{
+		RollbackPredictorStats const *predictor = stats->predictors + k;
+		char predictor_label[128], would_mispredict[128];
+
+		sprintf_s(
+			predictor_label,
+			COUNT_OF(predictor_label),
+			"Predictor %s:",
+			predictor->name);
+
+		sprintf_s(
+			would_mispredict,
+			COUNT_OF(would_mispredict),
+			"%.1f%% wrong",
+			predictor->predictions
+				? predictor->mispredictions * 100.0 / predictor->predictions
+				: 0);
+
+		ImGui::Columns(4, "", false);
+		ImGui::Text(predictor_label); ImGui::NextColumn();
+		ImGui::Text(would_mispredict); ImGui::NextColumn();
+		ImGui::Columns(1);
 	}
 
+	if (ImGui::Button("Export"))
+	{
+		rollback_export_stats(stats, "rollback_stats.csv");
+	}
+}
+#endif
+
+void draw_performance_monitor(
+	ClientState *cs, SimFrame const *frame, HudTextStats const *hud)
+{
+	if (!frame->has_stats)
+	{
+		return;
+	}
+
+	int num_remotes = frame->num_remotes;
+
 	static int graph_size = 0;
 	static int first_graph_index = 0;
 
@@ -233,13 +475,13 @@ void draw_performance_monitor(ClientState *cs)
 		first_graph_index = (first_graph_index + 1) % MAX_GRAPH_SIZE;
 	}
 
-	static float ping_graph[MAX_PLAYERS][MAX_GRAPH_SIZE] = { 0 };
-	static float remote_fairness_graph[MAX_PLAYERS][MAX_GRAPH_SIZE] = { 0 };
+	static float ping_graph[GGPO_MAX_PLAYERS][MAX_GRAPH_SIZE] = { 0 };
+	static float remote_fairness_graph[GGPO_MAX_PLAYERS][MAX_GRAPH_SIZE] = { 0 };
 	static float fairness_graph[MAX_GRAPH_SIZE] = { 0 };
 
 	for (int j = 0; j < num_remotes; j++)
 	{
-		ggpo_get_network_stats(ggpo.session, remotes[j], &stats);
+		stats = frame->network[j];
 
 		ping_graph[j][i] = (float)stats.network.ping;
 
@@ -320,6 +562,29 @@ void draw_performance_monitor(ClientState *cs)
 	ImGui::Text(latency_in_frames); ImGui::NextColumn();
 	ImGui::Columns(1);
 
+	char slewing[128], slewed[128];
+
+	sprintf_s(
+		slewing,
+		COUNT_OF(slewing),
+		"%.1f ms of %.1f ms",
+		frame->timesync.applied_ms,
+		frame->timesync.applied_ms + frame->timesync.pending_ms);
+
+	sprintf_s(
+		slewed,
+		COUNT_OF(slewed),
+		"%.1f ms, %lld times",
+		frame->timesync.total_applied_ms,
+		frame->timesync.corrections);
+
+	ImGui::Columns(4, "", false);
+	ImGui::Text("Time Sync:"); ImGui::NextColumn();
+	ImGui::Text(slewing); ImGui::NextColumn();
+	ImGui::Text("In Total:"); ImGui::NextColumn();
+	ImGui::Text(slewed); ImGui::NextColumn();
+	ImGui::Columns(1);
+
 	ImGui::Separator();
 	ImGui::Text("Synchronization");
 
@@ -377,6 +642,145 @@ void draw_performance_monitor(ClientState *cs)
 	ImGui::Text(local_frames_behind); ImGui::NextColumn();
 	ImGui::Columns(1);
 
+	ImGui::Separator();
+	ImGui::Text("Pacing");
+
+	PacerStats const *pacer_stats_now = &frame->pacer;
+	char tick_rate[128], tick_jitter[128], drawn[128], draw_calls[128];
+	char hud_formats[128], hud_measures[128], submitted[128];
+
+	sprintf_s(
+		tick_rate,
+		COUNT_OF(tick_rate),
+		"%.3f Hz, %lld dropped",
+		pacer_stats_now->hz,
+		pacer_stats_now->dropped);
+
+	sprintf_s(
+		tick_jitter,
+		COUNT_OF(tick_jitter),
+		"%.2f ms, %.2f to %.2f ms",
+		pacer_stats_now->jitter_ms,
+		pacer_stats_now->min_ms,
+		pacer_stats_now->max_ms);
+
+	ImGui::Columns(4, "", false);
+	ImGui::Text("Tick Rate:"); ImGui::NextColumn();
+	ImGui::Text(tick_rate); ImGui::NextColumn();
+	ImGui::Text("Jitter:"); ImGui::NextColumn();
+	ImGui::Text(tick_jitter); ImGui::NextColumn();
+	ImGui::Columns(1);
+
+	sprintf_s(
+		drawn,
+		COUNT_OF(drawn),
+		"%lld of %lld ticks",
+		sim_frames.taken,
+		frame->published);
+
+	RendererStats renderer_stats_now;
+	renderer_stats(&renderer_stats_now);
+
+	static char const *const backends[] = { "immediate", "batched", "unified" };
+
+	sprintf_s(
+		draw_calls,
+		COUNT_OF(draw_calls),
+		"%d %s, %d batched vertices",
+		renderer_stats_now.draw_calls,
+		backends[cs->backend],
+		renderer_stats_now.vertices);
+
+	sprintf_s(
+		submitted,
+		COUNT_OF(submitted),
+		"%d ImGui draw commands, %.3f ms CPU",
+		submit_cost.imgui_commands,
+		submit_cost.cpu_ms);
+
+	ImGui::Columns(4, "", false);
+	ImGui::Text("Drawn:"); ImGui::NextColumn();
+	ImGui::Text(drawn); ImGui::NextColumn();
+	ImGui::Text("Draw Calls:"); ImGui::NextColumn();
+	ImGui::Text(draw_calls); ImGui::NextColumn();
+	ImGui::Text("Submitted:"); ImGui::NextColumn();
+	ImGui::Text(submitted); ImGui::NextColumn();
+	ImGui::Columns(1);
+
+	sprintf_s(
+		hud_formats,
+		COUNT_OF(hud_formats),
+		"%d done, %d saved",
+		hud->formatted,
+		hud->formats_saved);
+
+	sprintf_s(
+		hud_measures,
+		COUNT_OF(hud_measures),
+		"%d done, %d saved",
+		hud->measured,
+		hud->measures_saved);
+
+	ImGui::Columns(4, "", false);
+	ImGui::Text("HUD Formats:"); ImGui::NextColumn();
+	ImGui::Text(hud_formats); ImGui::NextColumn();
+	ImGui::Text("HUD Measures:"); ImGui::NextColumn();
+	ImGui::Text(hud_measures); ImGui::NextColumn();
+	ImGui::Columns(1);
+
+#ifdef VECTORWAR_INTREE_ROLLBACK
+	draw_rollback_stats(&frame->rollback, frame->remotes, num_remotes);
+#endif
+
+	ImGui::Separator();
+	ImGui::Text("Snapshots");
+
+	SnapshotStats snapshot_stats = frame->snapshot;
+
+	char allocations_avoided[128], heap_allocations[128];
+
+	sprintf_s(
+		allocations_avoided,
+		COUNT_OF(allocations_avoided),
+		"%lld",
+		snapshot_stats.allocations_avoided);
+
+	sprintf_s(
+		heap_allocations,
+		COUNT_OF(heap_allocations),
+		"%lld",
+		snapshot_stats.heap_allocations);
+
+	ImGui::Columns(4, "", false);
+	ImGui::Text("Pooled:"); ImGui::NextColumn();
+	ImGui::Text(allocations_avoided); ImGui::NextColumn();
+	ImGui::Text("Heap:"); ImGui::NextColumn();
+	ImGui::Text(heap_allocations); ImGui::NextColumn();
+	ImGui::Columns(1);
+
+	char retained_frames[128], bytes_per_frame[128];
+
+	sprintf_s(
+		retained_frames,
+		COUNT_OF(retained_frames),
+		"%d",
+		snapshot_stats.retained_frames);
+
+	sprintf_s(
+		bytes_per_frame,
+		COUNT_OF(bytes_per_frame),
+		"%lld",
+		snapshot_stats.retained_frames
+			? snapshot_stats.retained_bytes / snapshot_stats.retained_frames
+			: 0);
+
+	ImGui::Columns(4, "", false);
+	ImGui::Text("Retained:"); ImGui::NextColumn();
+	ImGui::Text(retained_frames); ImGui::NextColumn();
+	ImGui::Text("Bytes/frame:"); ImGui::NextColumn();
+	ImGui::Text(bytes_per_frame); ImGui::NextColumn();
+	ImGui::Columns(1);
+
 	ImGui::Separator();
 
 	char pid[128];
@@ -392,15 +796,24 @@ void draw_performance_monitor(ClientState *cs)
 	ImGui::End();
 }
 
-static void draw_gui(SdlHandles handles, ClientState *cs)
+static void draw_gui(SdlHandles handles, ClientState *cs, SimFrame const *frame)
 {
-	draw_checksum(handles, frame_report.periodic, 18);
-	draw_checksum(handles, frame_report.current, 34);
-	draw_centered_text(handles, connection_report.status, 448);
+	static HudText periodic, current, status;
+
+	draw_checksum(handles, &periodic, frame->frame_report.periodic, 18);
+	draw_checksum(handles, &current, frame->frame_report.current, 34);
+	draw_centered_text(
+		handles,
+		hud_text_string(&status, frame->connection_report.status),
+		448);
+
+	// Every line of HUD text of the frame is in by now.
+	HudTextStats hud;
+	hud_text_stats(&hud);
 
 	if (cs->show_performance_monitor)
 	{
-		draw_performance_monitor(cs);
+		draw_performance_monitor(cs, frame, &hud);
 	}
 }
 
@@ -448,6 +861,15 @@ static void client_process_event(SDL_Event e, SdlHandles sdl, ClientState *cs)
 		{
 			cs->show_performance_monitor = !cs->show_performance_monitor;
 		}
+		else if (e.key.keysym.sym == SDLK_i)
+		{
+			cs->no_interpolation = !cs->no_interpolation;
+		}
+		else if (e.key.keysym.sym == SDLK_b)
+		{
+			cs->backend = (enum RENDERER_BACKEND)
+				((cs->backend + 1) % (RENDERER_BACKEND_unified + 1));
+		}
 		else if (e.key.keysym.sym == SDLK_ESCAPE)
 		{
 			cs->quit = true;
@@ -455,8 +877,9 @@ static void client_process_event(SDL_Event e, SdlHandles sdl, ClientState *cs)
 		}
 		else if (e.key.keysym.sym >= SDLK_F1 && e.key.keysym.sym <= SDLK_F12)
 		{
-			disconnect_player(
-				(int)(e.key.keysym.sym - SDLK_F1));
+			// Left to the simulation thread, which owns the session.
+			SDL_AtomicSet(
+				&disconnect_request, (int)(e.key.keysym.sym - SDLK_F1) + 1);
 		}
 		break;
 
@@ -494,12 +917,12 @@ static bool __cdecl advance_frame(int flags)
 	(void)flags;
 
 	int disconnect_flags = 0;
-	LocalInput inputs[MAX_PLAYERS] = { 0 };
+	LocalInput inputs[GGPO_MAX_PLAYERS] = { 0 };
 
 	GGPOErrorCode result = ggpo_synchronize_input(
 		ggpo.session,
 		(void*)inputs,
-		sizeof(LocalInput) * MAX_PLAYERS,
+		sizeof(LocalInput) * GGPO_MAX_PLAYERS,
 		&disconnect_flags);
 
 	if (GGPO_SUCCEEDED(result))
@@ -516,8 +939,6 @@ static bool __cdecl advance_frame(int flags)
 
 static void work(LocalInput *input)
 {
-	capture_input_state(input);
-
 	GGPOErrorCode result = ggpo_add_local_input(
 		ggpo.session,
 		ggpo.local_player,
@@ -530,57 +951,226 @@ static void work(LocalInput *input)
 	}
 }
 
-static void render(SdlHandles sdl)
+// SDL_Renderer and ImGui's renderer share the GL context. What was drawn
+// through SDL_Renderer has to be flushed first, and the shader program it
+// leaves bound undone for ImGui's fixed function pipeline. The unified backend
+// draws nothing through SDL_Renderer, so ImGui's renderer sets up GL state
+// and submits the whole frame alone, after a clear.
+static void render(SdlHandles sdl, enum RENDERER_BACKEND backend, Uint64 start)
 {
-	SDL_RenderFlush(sdl.renderer);
-	ImGui::Render();
-	sdl.glUseProgram(0);
-	ImGui_ImplOpenGL2_RenderDrawData(ImGui::GetDrawData());
+	if (backend == RENDERER_BACKEND_unified)
+	{
+		ImGui::Render();
+		glDisable(GL_SCISSOR_TEST);
+		glClearColor(0, 0, 0, 1);
+		glClear(GL_COLOR_BUFFER_BIT);
+	}
+	else
+	{
+		SDL_RenderFlush(sdl.renderer);
+		ImGui::Render();
+		sdl.glUseProgram(0);
+	}
+
+	ImDrawData *draw_data = ImGui::GetDrawData();
+	ImGui_ImplOpenGL2_RenderDrawData(draw_data);
+
+	double ms = (SDL_GetPerformanceCounter() - start) * 1000.0 /
+		SDL_GetPerformanceFrequency();
+
+	submit_cost.cpu_ms += (ms - submit_cost.cpu_ms) / 16;
+	submit_cost.imgui_commands = 0;
+
+	for (int i = 0; i < draw_data->CmdListsCount; i++)
+	{
+		submit_cost.imgui_commands += draw_data->CmdLists[i]->CmdBuffer.Size;
+	}
+
 	SDL_GL_SwapWindow(sdl.window);
 }
 
-static void main_loop(SdlHandles sdl)
+// Lengthens the next frame by some of the time sync correction left.
+static double slew_frame()
+{
+	if (timesync.pending_ms <= 0)
+	{
+		return 0;
+	}
+
+	double stretch = timesync_stretch(&timesync, 1000.0 / pacer.hz);
+
+	if (timesync.pending_ms <= 0)
+	{
+		SDL_Log("Time sync: applied %.1f ms, %.1f ms this session",
+			timesync.applied_ms,
+			timesync.total_applied_ms);
+	}
+
+	return stretch;
+}
+
+static void gather_stats(SimFrame *frame)
+{
+	frame->num_remotes = 0;
+
+	for (int i = 0; i < connection_report.num_participants; i++)
+	{
+		if (connection_report.participants[i].type == PARTICIPANT_TYPE_remote)
+		{
+			GGPOPlayerHandle handle = participants[i];
+
+			ggpo_get_network_stats(
+				ggpo.session, handle, frame->network + frame->num_remotes);
+
+			frame->remotes[frame->num_remotes++] = handle;
+		}
+	}
+
+	pacer_stats(&pacer, &frame->pacer);
+	frame->timesync = timesync;
+	game_snapshot_stats(&frame->snapshot);
+
+#ifdef VECTORWAR_INTREE_ROLLBACK
+	ggpo_get_rollback_stats(ggpo.session, &frame->rollback);
+#endif
+}
+
+static void publish_sim_frame()
+{
+	unsigned char *back = triple_buffer_back(&sim_frames);
+	SimFrame *frame = (SimFrame*)back;
+	GameState const *state = game_state();
+
+	frame->connection_report = connection_report;
+	frame->frame_report = frame_report;
+	frame->published = sim_frames.published + 1;
+	frame->tick = pacer.last_tick;
+	frame->state_stride = (state->size + 7) & ~7;
+	frame->has_stats = SDL_AtomicGet(&sim_wants_stats) != 0;
+
+	if (frame->has_stats)
+	{
+		gather_stats(frame);
+	}
+
+	unsigned char *states = back + SIM_FRAME_HEADER_SIZE;
+
+	memcpy(states, last_published_state, state->size);
+	memcpy(states + frame->state_stride, state, state->size);
+	memcpy(last_published_state, state, state->size);
+
+	triple_buffer_publish(&sim_frames);
+}
+
+// Runs the session and the game on the pacer, so that a render stalled on
+// vsync holds up neither, and publishes a frame to draw after every tick.
+static int SDLCALL sim_thread(void *data)
+{
+	(void)data;
+
+	while (!SDL_AtomicGet(&sim_quit))
+	{
+		int player = SDL_AtomicSet(&disconnect_request, 0);
+
+		if (player)
+		{
+			disconnect_player(player - 1);
+		}
+
+		// GGPO polls while it waits, the pacer takes care of the last stretch.
+		ggpo_idle(
+			ggpo.session,
+			max(0, (int)pacer_ms_to_tick(&pacer) - PACER_SPIN_MS));
+
+		pacer_wait(&pacer);
+
+		while (pacer_tick(&pacer))
+		{
+			LocalInput input = { SDL_AtomicGet(&shared_input) };
+
+			work(&input);
+			pacer_delay(&pacer, slew_frame());
+		}
+
+		publish_sim_frame();
+	}
+
+	return 0;
+}
+
+// Returns false if the simulation couldn't be started.
+static int main_loop(SdlHandles sdl)
 {
 	frame_report = { 0 };
+	timesync = { 0 };
+	pacer_start(&pacer, 60);
+
+	SDL_AtomicSet(&sim_quit, 0);
+	memcpy(last_published_state, game_state(), game_state()->size);
+	publish_sim_frame();
 
-	int start, next, now;
-	start = next = now = SDL_GetTicks();
+	SDL_Thread *sim = SDL_CreateThread(sim_thread, "simulation", NULL);
+
+	if (!sim)
+	{
+		SDL_Log("Could not start the simulation: %s", SDL_GetError());
+		return false;
+	}
 
 	ClientState client_state = { 0 };
 	LocalInput local_input = { 0 };
 
-	while (1)
+	client_state.backend = RENDERER_BACKEND_unified;
+
+	while (!client_state.quit)
 	{
 		setup_imgui_frame(sdl);
 
 		SDL_Event e;
 
-		while (SDL_PollEvent(&e) != 0)
+		while (!client_state.quit && SDL_PollEvent(&e) != 0)
 		{
 			client_process_event(e, sdl, &client_state);
-
-			if (client_state.quit)
-			{
-				return;
-			}
-
 			buffer_event(&e, &local_input);
 		}
 
-		now = SDL_GetTicks();
-		ggpo_idle(ggpo.session, max(0, next - now - 1));
+		capture_input_state(&local_input);
+		SDL_AtomicSet(&shared_input, local_input.inputs);
+		SDL_AtomicSet(
+			&sim_wants_stats, client_state.show_performance_monitor);
+
+		SimFrame const *frame =
+			(SimFrame const*)triple_buffer_front(&sim_frames);
+
+		GameState const *state = sim_frame_state(frame, 1);
 
-		if (now >= next)
+		// A tick behind, drawn as far along towards the latest tick as the
+		// time since it, so that motion is smooth at any display rate.
+		if (!client_state.no_interpolation)
 		{
-			work(&local_input);
-			local_input = { 0 };
-			next = now + (1000 / 60);
+			interpolate_game_state(
+				sim_frame_state(frame, 0),
+				state,
+				pacer_alpha_since(
+					&pacer, frame->tick, SDL_GetPerformanceCounter()),
+				interpolated_state);
+
+			state = interpolated_state;
 		}
 
-		draw_game(sdl.renderer, &connection_report);
-		draw_gui(sdl, &client_state);
-		render(sdl);
+		Uint64 start = SDL_GetPerformanceCounter();
+
+		renderer_set_backend(client_state.backend);
+		draw(sdl.renderer, state, &frame->connection_report);
+
+		draw_gui(sdl, &client_state, frame);
+		render(sdl, client_state.backend, start);
 	}
+
+	SDL_AtomicSet(&sim_quit, 1);
+	SDL_WaitThread(sim, NULL);
+
+	return true;
 }
 
 static SdlHandles setup_sdl()
@@ -652,7 +1242,7 @@ static void show_syntax_error()
 {
 	SDL_ShowSimpleMessageBox(
 		SDL_MESSAGEBOX_ERROR,
-		"Syntax: hey.exe <local port> <num players> ('local' | <remote ip>:<remote port>)*\n",
+		"Syntax: hey.exe [--checksum fletcher32|stripe] [--keyframes n] [--predictor repeat|hold|learned] <local port> <num players> ('local' | <remote ip>:<remote port>)*\n",
 		"Could not start",
 		NULL);
 }
@@ -667,10 +1257,53 @@ static int parse_args(int argc, char* args[], ClientInit *init)
 
 	int offset = 1;
 
+	init->checksum = CHECKSUM_fletcher32;
+	init->keyframes = 0;
+	init->predictor = "repeat";
+
+	while (argc >= offset + 2 && !strncmp(args[offset], "--", 2))
+	{
+		const char* option = args[offset];
+		const char* value = args[offset + 1];
+
+		if (!strcmp(option, "--checksum") && !strcmp(value, "stripe"))
+		{
+			init->checksum = CHECKSUM_stripe;
+		}
+		else if (!strcmp(option, "--checksum") && !strcmp(value, "fletcher32"))
+		{
+			init->checksum = CHECKSUM_fletcher32;
+		}
+		else if (!strcmp(option, "--keyframes") && atoi(value) > 0)
+		{
+			init->keyframes = atoi(value);
+		}
+#ifdef VECTORWAR_INTREE_ROLLBACK
+		else if (!strcmp(option, "--predictor"))
+		{
+			init->predictor = value;
+		}
+#endif
+		else
+		{
+			show_syntax_error();
+			return 1;
+		}
+
+		offset += 2;
+	}
+
+	if (argc < offset + 2)
+	{
+		show_syntax_error();
+		return 1;
+	}
+
 	init->local_port = (unsigned short)atoi(args[offset]);
 	offset++;
 
 	init->num_players = atoi(args[offset]);
+	init->max_bullets = DEFAULT_MAX_BULLETS;
 	offset++;
 
 	if (init->num_players < 0 || argc < offset + init->num_players)
@@ -764,20 +1397,19 @@ static int parse_args(int argc, char* args[], ClientInit *init)
 
 static void adjust_window(SdlHandles const sdl, ClientInit const init)
 {
-	SDL_Point window_offsets[] = {
-		{ 64,  64 },
-		{ 740, 64 },
-		{ 64,  600 },
-		{ 740, 600 },
-	};
-
-	if (init.local_player < COUNT_OF(window_offsets))
+	if (init.type != ROLE_TYPE_Player)
 	{
-		SDL_SetWindowPosition(
-			sdl.window,
-			window_offsets[init.local_player].x,
-			window_offsets[init.local_player].y);
+		return;
 	}
+
+	// Tile the first four players' windows, then cascade over them.
+	int i = init.local_player;
+	int cascade = 24 * (i / 4);
+
+	SDL_SetWindowPosition(
+		sdl.window,
+		64 + 676 * (i % 2) + cascade,
+		64 + 536 * ((i / 2) % 2) + cascade);
 }
 
 static bool __cdecl begin_game_callback(const char *game)
@@ -853,6 +1485,10 @@ static void setup_ggpo(ClientInit init)
 	ggpo_set_disconnect_timeout(handles.session, 3000);
 	ggpo_set_disconnect_notify_start(handles.session, 1000);
 
+#ifdef VECTORWAR_INTREE_ROLLBACK
+	ggpo_use_predictor(handles.session, init.predictor);
+#endif
+
 	for (int i = 0; i < init.num_players + init.num_spectators; i++)
 	{
 		GGPOPlayerHandle handle;
@@ -872,6 +1508,9 @@ static void setup_ggpo(ClientInit init)
 			connection_report.participants[i].connect_progress = 100;
 			set_connection_state(handle, CONNECTION_STATE_connecting);
 			ggpo_set_frame_delay(handles.session, handle, 2);
+#ifdef VECTORWAR_INTREE_ROLLBACK
+			ggpo_set_adaptive_frame_delay(handles.session, handle, 0, 6);
+#endif
 		}
 		else
 		{
@@ -910,14 +1549,45 @@ int main(int argc, char* args[])
 	adjust_window(sdl, init);
 	setup_ggpo(init);
 	setup_imgui(sdl);
-	setup_game(sdl.window, init.num_players);
+	int w, h;
+	SDL_GetWindowSize(sdl.window, &w, &h);
 
-	main_loop(sdl);
+	if (!setup_game(w, h, init.num_players, init.max_bullets))
+	{
+		return 1;
+	}
+
+	game_set_checksum(init.checksum);
+
+	if (!game_set_snapshot_keyframes(init.keyframes))
+	{
+		return 1;
+	}
+
+	int state_stride = (game_state()->size + 7) & ~7;
 
+	last_published_state = (unsigned char*)malloc(state_stride);
+	interpolated_state = (GameState*)malloc(state_stride);
+
+	if (!last_published_state ||
+		!interpolated_state ||
+		!triple_buffer_create(
+			&sim_frames, SIM_FRAME_HEADER_SIZE + state_stride * 2))
+	{
+		return 1;
+	}
+
+	int started = main_loop(sdl);
+
+	triple_buffer_destroy(&sim_frames);
+	free(last_published_state);
+	free(interpolated_state);
+
+	renderer_tear_down();
 	tear_down_game();
 	tear_down_imgui();
 	tear_down_ggpo();
 	tear_down_sdl(sdl);
 
-	return 0;
+	return started ? 0 : 1;
 }
@@ -0,0 +1,355 @@
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "netsim.h"
+#include "timer.h"
+
+typedef struct NetsimPacket
+{
+	int peer;
+	unsigned int delivery_ms;
+	int len;
+	unsigned char *data;
+} NetsimPacket;
+
+void netsim_create(
+	Netsim *netsim, RollbackTransport const *inner, unsigned int seed)
+{
+	memset(netsim, 0, sizeof(*netsim));
+
+	while (!seed)
+	{
+		seed = (unsigned int)(time(NULL) ^ timer_ticks());
+	}
+
+	netsim->inner = *inner;
+	netsim->seed = seed;
+	netsim->random = seed;
+}
+
+void netsim_destroy(Netsim *netsim)
+{
+	for (int i = 0; i < netsim->num_packets; i++)
+	{
+		free(netsim->packets[i].data);
+	}
+
+	free(netsim->packets);
+	memset(netsim, 0, sizeof(*netsim));
+}
+
+void netsim_set_link(Netsim *netsim, int peer, NetsimLink const *link)
+{
+	for (int i = 0; i < ROLLBACK_MAX_PLAYERS; i++)
+	{
+		if (peer < 0 || peer == i)
+		{
+			netsim->links[i] = *link;
+		}
+	}
+}
+
+static int matches(char const *name, size_t len, char const *expected)
+{
+	return len == strlen(expected) && !strncmp(name, expected, len);
+}
+
+int netsim_parse_link(char const *settings, NetsimLink *link)
+{
+	memset(link, 0, sizeof(*link));
+
+	while (*settings)
+	{
+		char const *value = strchr(settings, '=');
+		size_t name_len = value ? (size_t)(value - settings) : 0;
+		char *end;
+
+		if (!value)
+		{
+			return false;
+		}
+
+		value++;
+
+		if (matches(settings, name_len, "distribution"))
+		{
+			size_t value_len = strcspn(value, ",");
+
+			if (matches(value, value_len, "uniform"))
+			{
+				link->distribution = NETSIM_DISTRIBUTION_uniform;
+			}
+			else if (matches(value, value_len, "normal"))
+			{
+				link->distribution = NETSIM_DISTRIBUTION_normal;
+			}
+			else if (matches(value, value_len, "pareto"))
+			{
+				link->distribution = NETSIM_DISTRIBUTION_pareto;
+			}
+			else
+			{
+				return false;
+			}
+
+			end = (char*)value + value_len;
+		}
+		else
+		{
+			double number = strtod(value, &end);
+
+			if (end == value || number < 0)
+			{
+				return false;
+			}
+
+			if (matches(settings, name_len, "latency"))
+			{
+				link->latency_ms = (unsigned int)number;
+			}
+			else if (matches(settings, name_len, "jitter"))
+			{
+				link->jitter_ms = (unsigned int)number;
+			}
+			else if (matches(settings, name_len, "loss"))
+			{
+				link->loss = (float)number;
+			}
+			else if (matches(settings, name_len, "burst"))
+			{
+				link->burst = (float)number;
+			}
+			else if (matches(settings, name_len, "duplicate"))
+			{
+				link->duplicate = (float)number;
+			}
+			else if (matches(settings, name_len, "reorder"))
+			{
+				link->reorder = (float)number;
+			}
+			else
+			{
+				return false;
+			}
+		}
+
+		if (*end == ',')
+		{
+			end++;
+		}
+		else if (*end)
+		{
+			return false;
+		}
+
+		settings = end;
+	}
+
+	return true;
+}
+
+// splitmix64, to 0 <= x < 1.
+static double next_random(Netsim *netsim)
+{
+	unsigned long long z = (netsim->random += 0x9e3779b97f4a7c15ull);
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+	z ^= z >> 31;
+	return (z >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static unsigned int sample_latency(Netsim *netsim, NetsimLink const *link)
+{
+	double latency = link->latency_ms;
+	double jitter = link->jitter_ms;
+
+	switch (link->distribution)
+	{
+	case NETSIM_DISTRIBUTION_uniform:
+		latency += jitter * (2 * next_random(netsim) - 1);
+		break;
+
+	case NETSIM_DISTRIBUTION_normal:
+	{
+		// Box-Muller.
+		double u = 1 - next_random(netsim);
+		double v = next_random(netsim);
+		latency += jitter * sqrt(-2 * log(u)) * cos(6.283185307179586 * v);
+		break;
+	}
+
+	case NETSIM_DISTRIBUTION_pareto:
+		// Shape 2, scaled for a mean of jitter.
+		latency += jitter * (1 / sqrt(1 - next_random(netsim)) - 1);
+		break;
+	}
+
+	return latency > 0 ? (unsigned int)(latency + 0.5) : 0;
+}
+
+static void hold(
+	Netsim *netsim,
+	int peer,
+	void const *data,
+	int len,
+	unsigned int delivery_ms)
+{
+	if (netsim->num_packets == netsim->capacity)
+	{
+		int capacity = netsim->capacity ? netsim->capacity * 2 : 64;
+		NetsimPacket *packets = (NetsimPacket*)realloc(
+			netsim->packets, capacity * sizeof(NetsimPacket));
+
+		if (!packets)
+		{
+			return;
+		}
+
+		netsim->packets = packets;
+		netsim->capacity = capacity;
+	}
+
+	unsigned char *copy = (unsigned char*)malloc(len);
+
+	if (!copy)
+	{
+		return;
+	}
+
+	memcpy(copy, data, len);
+
+	// After everything due at the same time or earlier.
+	int i = netsim->num_packets;
+
+	while (i > 0 &&
+		(int)(netsim->packets[i - 1].delivery_ms - delivery_ms) > 0)
+	{
+		i--;
+	}
+
+	memmove(netsim->packets + i + 1,
+		netsim->packets + i,
+		(netsim->num_packets - i) * sizeof(NetsimPacket));
+
+	netsim->packets[i].peer = peer;
+	netsim->packets[i].delivery_ms = delivery_ms;
+	netsim->packets[i].len = len;
+	netsim->packets[i].data = copy;
+	netsim->num_packets++;
+}
+
+static void flush(Netsim *netsim)
+{
+	unsigned int now = netsim->inner.now_ms(netsim->inner.context);
+	int due = 0;
+
+	while (due < netsim->num_packets &&
+		(int)(now - netsim->packets[due].delivery_ms) >= 0)
+	{
+		NetsimPacket *packet = netsim->packets + due++;
+
+		netsim->inner.send(
+			netsim->inner.context, packet->peer, packet->data, packet->len);
+
+		free(packet->data);
+	}
+
+	memmove(netsim->packets,
+		netsim->packets + due,
+		(netsim->num_packets - due) * sizeof(NetsimPacket));
+
+	netsim->num_packets -= due;
+}
+
+static void netsim_send(void *context, int peer, void const *data, int len)
+{
+	Netsim *netsim = (Netsim*)context;
+
+	if (peer < 0 || peer >= ROLLBACK_MAX_PLAYERS)
+	{
+		return;
+	}
+
+	NetsimLink const *link = netsim->links + peer;
+	unsigned int now = netsim->inner.now_ms(netsim->inner.context);
+
+	netsim->stats.sent++;
+
+	// Gilbert's two state model: a loss starts a burst, which then ends
+	// after a datagram with a chance of 1 / burst.
+	if (netsim->losing[peer])
+	{
+		netsim->losing[peer] = next_random(netsim) * link->burst >= 1;
+	}
+	else
+	{
+		netsim->losing[peer] = next_random(netsim) < link->loss;
+	}
+
+	if (netsim->losing[peer])
+	{
+		netsim->stats.dropped++;
+		return;
+	}
+
+	int copies = next_random(netsim) < link->duplicate ? 2 : 1;
+
+	netsim->stats.duplicated += copies - 1;
+
+	for (int i = 0; i < copies; i++)
+	{
+		unsigned int delivery = now + sample_latency(netsim, link);
+		int last = (int)(netsim->last_delivery_ms[peer] - now);
+
+		// Skips the queue, overtaking whatever is still on the way.
+		if (next_random(netsim) < link->reorder)
+		{
+			delivery = now;
+			netsim->stats.reordered++;
+		}
+		else
+		{
+			// Not before anything sent earlier, as a queue on the way would.
+			if (last > 0 && (int)(delivery - now) < last)
+			{
+				delivery = now + last;
+			}
+
+			netsim->last_delivery_ms[peer] = delivery;
+		}
+
+		hold(netsim, peer, data, len, delivery);
+	}
+
+	flush(netsim);
+}
+
+static int netsim_receive(void *context, int *peer, void *data, int capacity)
+{
+	Netsim *netsim = (Netsim*)context;
+
+	flush(netsim);
+
+	return netsim->inner.receive(netsim->inner.context, peer, data, capacity);
+}
+
+static unsigned int netsim_now_ms(void *context)
+{
+	Netsim *netsim = (Netsim*)context;
+
+	return netsim->inner.now_ms(netsim->inner.context);
+}
+
+RollbackTransport netsim_transport(Netsim *netsim)
+{
+	RollbackTransport transport;
+
+	transport.context = netsim;
+	transport.send = netsim_send;
+	transport.receive = netsim_receive;
+	transport.now_ms = netsim_now_ms;
+
+	return transport;
+}
@@ -0,0 +1,87 @@
+#ifndef _NETSIM_H_
+#define _NETSIM_H_
+
+#include "rollback.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum NETSIM_DISTRIBUTION
+{
+	// latency, give or take up to jitter.
+	NETSIM_DISTRIBUTION_uniform,
+	// latency, with jitter as the standard deviation.
+	NETSIM_DISTRIBUTION_normal,
+	// latency, plus a long tail averaging jitter.
+	NETSIM_DISTRIBUTION_pareto,
+};
+
+// How datagrams sent over one link fare. Rates are from 0 to 1.
+typedef struct NetsimLink
+{
+	unsigned int latency_ms;
+	unsigned int jitter_ms;
+	enum NETSIM_DISTRIBUTION distribution;
+	// The chance a datagram starts a burst of losses, and the average length
+	// of a burst.
+	float loss;
+	float burst;
+	float duplicate;
+	// The chance a datagram arrives right away, ahead of those sent before.
+	// Otherwise datagrams keep their order, however late.
+	float reorder;
+} NetsimLink;
+
+typedef struct NetsimStats
+{
+	long long sent;
+	long long dropped;
+	long long duplicated;
+	long long reordered;
+} NetsimStats;
+
+struct NetsimPacket;
+
+// A RollbackTransport that goes through another, making the datagrams sent
+// late, lost, doubled or out of order on the way. Draws from its own seeded
+// generator, so a run with the same seed and the same traffic fares the
+// same. All links are perfect until set.
+typedef struct Netsim
+{
+	RollbackTransport inner;
+	unsigned int seed;
+	unsigned long long random;
+	NetsimLink links[ROLLBACK_MAX_PLAYERS];
+	int losing[ROLLBACK_MAX_PLAYERS];
+	unsigned int last_delivery_ms[ROLLBACK_MAX_PLAYERS];
+	// Held back, by time of delivery.
+	struct NetsimPacket *packets;
+	int num_packets;
+	int capacity;
+	NetsimStats stats;
+} Netsim;
+
+// A seed of 0 picks one, which is then in netsim->seed to replay the run.
+void netsim_create(
+	Netsim *netsim,
+	RollbackTransport const *inner,
+	unsigned int seed);
+
+void netsim_destroy(Netsim *netsim);
+
+// A peer of -1 sets every link.
+void netsim_set_link(Netsim *netsim, int peer, NetsimLink const *link);
+
+// Reads a link from comma separated settings, such as
+// "latency=80,jitter=10,distribution=normal,loss=0.02,burst=3,duplicate=0.01,
+// reorder=0.05". Those left out are perfect.
+int netsim_parse_link(char const *settings, NetsimLink *link);
+
+RollbackTransport netsim_transport(Netsim *netsim);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ifndef _NETSIM_H_
@@ -0,0 +1,345 @@
+#include <imgui.h>
+#include <SDL.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "offscreen.h"
+#include "renderer.h"
+#include "timer.h"
+
+// Where a point lies against the edge from a to b, twice the area of the
+// triangle they make.
+static inline float edge(ImVec2 a, ImVec2 b, float x, float y)
+{
+	return (b.x - a.x) * (y - a.y) - (b.y - a.y) * (x - a.x);
+}
+
+// Pixels whose centres lie exactly on an edge belong to one of the two
+// triangles sharing it, so that the seams of quads aren't blended twice.
+static inline bool owns_edge(ImVec2 a, ImVec2 b)
+{
+	return b.y < a.y || (b.y == a.y && b.x > a.x);
+}
+
+static inline Uint32 blend(Uint32 dst, ImU32 col, int alpha)
+{
+	int r = (col >> IM_COL32_R_SHIFT) & 0xff;
+	int g = (col >> IM_COL32_G_SHIFT) & 0xff;
+	int b = (col >> IM_COL32_B_SHIFT) & 0xff;
+	int inverse = 255 - alpha;
+
+	r = (r * alpha + (int)((dst >> 16) & 0xff) * inverse) / 255;
+	g = (g * alpha + (int)((dst >> 8) & 0xff) * inverse) / 255;
+	b = (b * alpha + (int)(dst & 0xff) * inverse) / 255;
+
+	return 0xff000000 | (r << 16) | (g << 8) | b;
+}
+
+// The nearest, clamped to the edges.
+static inline int texel(
+	Offscreen const *offscreen, unsigned char const *texture, float u, float v)
+{
+	int x = (int)(u * offscreen->font_width);
+	int y = (int)(v * offscreen->font_height);
+
+	x = SDL_max(0, SDL_min(offscreen->font_width - 1, x));
+	y = SDL_max(0, SDL_min(offscreen->font_height - 1, y));
+
+	return texture[y * offscreen->font_width + x];
+}
+
+static inline ImU32 lerp_color(
+	ImU32 c0, ImU32 c1, ImU32 c2, float b0, float b1, float b2)
+{
+	ImU32 out = 0;
+
+	for (int shift = 0; shift < 32; shift += 8)
+	{
+		float c = ((c0 >> shift) & 0xff) * b0 +
+			((c1 >> shift) & 0xff) * b1 +
+			((c2 >> shift) & 0xff) * b2;
+
+		out |= (ImU32)(c + 0.5f) << shift;
+	}
+
+	return out;
+}
+
+// Samples the nearest texel, and colors by vertex. Solid geometry, all of
+// whose vertices sit on the atlas' white pixel, and triangles of one color,
+// which is nearly all of them, skip the interpolation they don't need.
+static void raster_triangle(
+	Offscreen *offscreen,
+	ImDrawVert const *v0,
+	ImDrawVert const *v1,
+	ImDrawVert const *v2,
+	unsigned char const *texture,
+	SDL_Rect const *clip)
+{
+	float area = edge(v0->pos, v1->pos, v2->pos.x, v2->pos.y);
+
+	if (area == 0)
+	{
+		return;
+	}
+
+	if (area < 0)
+	{
+		ImDrawVert const *swap = v1;
+		v1 = v2;
+		v2 = swap;
+		area = -area;
+	}
+
+	float left = SDL_min(v0->pos.x, SDL_min(v1->pos.x, v2->pos.x));
+	float right = SDL_max(v0->pos.x, SDL_max(v1->pos.x, v2->pos.x));
+	float top = SDL_min(v0->pos.y, SDL_min(v1->pos.y, v2->pos.y));
+	float bottom = SDL_max(v0->pos.y, SDL_max(v1->pos.y, v2->pos.y));
+
+	int x0 = SDL_max(clip->x, (int)floorf(left));
+	int x1 = SDL_min(clip->x + clip->w, (int)ceilf(right));
+	int y0 = SDL_max(clip->y, (int)floorf(top));
+	int y1 = SDL_min(clip->y + clip->h, (int)ceilf(bottom));
+
+	if (x0 >= x1 || y0 >= y1)
+	{
+		return;
+	}
+
+	bool own0 = owns_edge(v1->pos, v2->pos);
+	bool own1 = owns_edge(v2->pos, v0->pos);
+	bool own2 = owns_edge(v0->pos, v1->pos);
+
+	bool solid = !texture ||
+		(v0->uv.x == v1->uv.x && v0->uv.x == v2->uv.x &&
+			v0->uv.y == v1->uv.y && v0->uv.y == v2->uv.y);
+	bool flat = v0->col == v1->col && v0->col == v2->col;
+	int solid_alpha = 255;
+
+	if (solid && texture)
+	{
+		solid_alpha = texel(offscreen, texture, v0->uv.x, v0->uv.y);
+	}
+
+	// Steps of each edge function along x.
+	float step0 = -(v2->pos.y - v1->pos.y);
+	float step1 = -(v0->pos.y - v2->pos.y);
+	float step2 = -(v1->pos.y - v0->pos.y);
+
+	SDL_Surface *surface = offscreen->surface;
+	offscreen->triangles++;
+
+	for (int y = y0; y < y1; y++)
+	{
+		Uint32 *row = (Uint32*)((Uint8*)surface->pixels + y * surface->pitch);
+		float cx = x0 + 0.5f;
+		float cy = y + 0.5f;
+		float w0 = edge(v1->pos, v2->pos, cx, cy);
+		float w1 = edge(v2->pos, v0->pos, cx, cy);
+		float w2 = edge(v0->pos, v1->pos, cx, cy);
+
+		for (int x = x0; x < x1; x++, w0 += step0, w1 += step1, w2 += step2)
+		{
+			if (w0 < 0 || w1 < 0 || w2 < 0 ||
+				(w0 == 0 && !own0) ||
+				(w1 == 0 && !own1) ||
+				(w2 == 0 && !own2))
+			{
+				continue;
+			}
+
+			float b0 = w0 / area;
+			float b1 = w1 / area;
+			float b2 = w2 / area;
+			ImU32 col = flat
+				? v0->col
+				: lerp_color(v0->col, v1->col, v2->col, b0, b1, b2);
+			int alpha = solid_alpha;
+
+			if (!solid)
+			{
+				float u = v0->uv.x * b0 + v1->uv.x * b1 + v2->uv.x * b2;
+				float v = v0->uv.y * b0 + v1->uv.y * b1 + v2->uv.y * b2;
+
+				alpha = texel(offscreen, texture, u, v);
+			}
+
+			alpha = alpha * (int)((col >> IM_COL32_A_SHIFT) & 0xff) / 255;
+
+			if (alpha)
+			{
+				row[x] = blend(row[x], col, alpha);
+			}
+		}
+	}
+}
+
+static void raster_draw_data(Offscreen *offscreen, ImDrawData const *data)
+{
+	offscreen->triangles = 0;
+
+	if (SDL_MUSTLOCK(offscreen->surface))
+	{
+		SDL_LockSurface(offscreen->surface);
+	}
+
+	for (int i = 0; i < data->CmdListsCount; i++)
+	{
+		ImDrawList const *list = data->CmdLists[i];
+		ImDrawVert const *vertices = list->VtxBuffer.Data;
+		ImDrawIdx const *indices = list->IdxBuffer.Data;
+
+		for (int j = 0; j < list->CmdBuffer.Size; j++)
+		{
+			ImDrawCmd const *cmd = &list->CmdBuffer[j];
+
+			if (cmd->UserCallback)
+			{
+				if (cmd->UserCallback != ImDrawCallback_ResetRenderState)
+				{
+					cmd->UserCallback(list, cmd);
+				}
+
+				indices += cmd->ElemCount;
+				continue;
+			}
+
+			ImVec4 r = cmd->ClipRect;
+			int x0 = SDL_max(0, (int)(r.x - data->DisplayPos.x));
+			int y0 = SDL_max(0, (int)(r.y - data->DisplayPos.y));
+			int x1 = SDL_min(
+				offscreen->surface->w, (int)(r.z - data->DisplayPos.x));
+			int y1 = SDL_min(
+				offscreen->surface->h, (int)(r.w - data->DisplayPos.y));
+			SDL_Rect clip = { x0, y0, x1 - x0, y1 - y0 };
+
+			// The atlas is the only texture ImGui is given.
+			unsigned char const *texture =
+				cmd->TextureId == (ImTextureID)offscreen ? offscreen->font : NULL;
+
+			for (unsigned int k = 0; clip.w > 0 && clip.h > 0 &&
+				k + 2 < cmd->ElemCount; k += 3)
+			{
+				raster_triangle(
+					offscreen,
+					vertices + cmd->VtxOffset + indices[k],
+					vertices + cmd->VtxOffset + indices[k + 1],
+					vertices + cmd->VtxOffset + indices[k + 2],
+					texture,
+					&clip);
+			}
+
+			indices += cmd->ElemCount;
+		}
+	}
+
+	if (SDL_MUSTLOCK(offscreen->surface))
+	{
+		SDL_UnlockSurface(offscreen->surface);
+	}
+}
+
+int offscreen_create(Offscreen *offscreen, int width, int height)
+{
+	memset(offscreen, 0, sizeof(*offscreen));
+
+	offscreen->surface = SDL_CreateRGBSurfaceWithFormat(
+		0, width, height, 32, SDL_PIXELFORMAT_ARGB8888);
+
+	if (!offscreen->surface)
+	{
+		return false;
+	}
+
+	offscreen->renderer = SDL_CreateSoftwareRenderer(offscreen->surface);
+
+	if (!offscreen->renderer)
+	{
+		offscreen_destroy(offscreen);
+		return false;
+	}
+
+	ImGui::CreateContext();
+
+	ImGuiIO &io = ImGui::GetIO();
+	unsigned char *pixels;
+	int bytes_per_pixel;
+
+	io.IniFilename = NULL;
+	io.DisplaySize = ImVec2((float)width, (float)height);
+	io.Fonts->GetTexDataAsAlpha8(
+		&pixels, &offscreen->font_width, &offscreen->font_height,
+		&bytes_per_pixel);
+
+	size_t font_size =
+		(size_t)offscreen->font_width * offscreen->font_height;
+
+	offscreen->font = (unsigned char*)malloc(font_size);
+
+	if (!offscreen->font)
+	{
+		ImGui::DestroyContext();
+		offscreen_destroy(offscreen);
+		return false;
+	}
+
+	memcpy(offscreen->font, pixels, font_size);
+	io.Fonts->TexID = (ImTextureID)offscreen;
+
+	return true;
+}
+
+void offscreen_destroy(Offscreen *offscreen)
+{
+	if (offscreen->font)
+	{
+		ImGui::DestroyContext();
+		free(offscreen->font);
+	}
+
+	if (offscreen->renderer)
+	{
+		SDL_DestroyRenderer(offscreen->renderer);
+	}
+
+	if (offscreen->surface)
+	{
+		SDL_FreeSurface(offscreen->surface);
+	}
+
+	memset(offscreen, 0, sizeof(*offscreen));
+}
+
+void offscreen_draw(
+	Offscreen *offscreen,
+	struct GameState const *gs,
+	struct ConnectionReport const *cr)
+{
+	long long start = timer_ticks();
+
+	ImGui::GetIO().DeltaTime = 1.0f / 60;
+	ImGui::NewFrame();
+
+	// The unified backend leaves clearing to its caller, as with GL.
+	if (renderer_backend() == RENDERER_BACKEND_unified)
+	{
+		SDL_FillRect(offscreen->surface, NULL, 0xff000000);
+	}
+
+	draw(offscreen->renderer, gs, cr);
+
+	ImGui::Render();
+
+	long long drawn = timer_ticks();
+
+	SDL_RenderFlush(offscreen->renderer);
+	raster_draw_data(offscreen, ImGui::GetDrawData());
+
+	offscreen->draw_ns = timer_ticks_to_ns(drawn - start);
+	offscreen->raster_ns = timer_ticks_to_ns(timer_ticks() - drawn);
+}
+
+int offscreen_save(Offscreen const *offscreen, char const *filename)
+{
+	return SDL_SaveBMP(offscreen->surface, filename) == 0;
+}
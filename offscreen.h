@@ -0,0 +1,52 @@
+#ifndef _OFFSCREEN_H_
+#define _OFFSCREEN_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct ConnectionReport;
+struct GameState;
+struct SDL_Renderer;
+struct SDL_Surface;
+
+// Draws frames as the client does, without a window or GL, so that the cost
+// of rendering can be measured anywhere. draw runs on SDL's software renderer
+// into a surface in memory, and ImGui's draw lists, the overlay, are then
+// rasterized into the same surface.
+typedef struct Offscreen
+{
+	struct SDL_Surface *surface;
+	struct SDL_Renderer *renderer;
+	// The font atlas, an alpha per texel.
+	unsigned char *font;
+	int font_width;
+	int font_height;
+	// Of the overlay, in the last frame.
+	int triangles;
+	// The last frame's time in draw and ImGui, which is building geometry,
+	// and then in SDL's renderer and rasterizing the overlay, putting it in
+	// pixels.
+	double draw_ns;
+	double raster_ns;
+} Offscreen;
+
+// Also creates the ImGui context, which the renderer draws the overlay into.
+// Returns false on failure.
+int offscreen_create(Offscreen *offscreen, int width, int height);
+
+void offscreen_destroy(Offscreen *offscreen);
+
+void offscreen_draw(
+	Offscreen *offscreen,
+	struct GameState const *game_state,
+	struct ConnectionReport const *connection_report);
+
+// Writes the last frame drawn as a BMP. Returns false on failure.
+int offscreen_save(Offscreen const *offscreen, char const *filename);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ifndef _OFFSCREEN_H_
@@ -0,0 +1,149 @@
+#include <math.h>
+#include <stdbool.h>
+#include <SDL.h>
+#include "pacer.h"
+
+static unsigned long long accumulate(Pacer *pacer)
+{
+	unsigned long long now = SDL_GetPerformanceCounter();
+
+	pacer->accumulator += (long long)((now - pacer->last) * pacer->hz);
+	pacer->last = now;
+
+	return now;
+}
+
+void pacer_start(Pacer *pacer, int hz)
+{
+	SDL_memset(pacer, 0, sizeof(*pacer));
+
+	pacer->hz = hz;
+	pacer->frequency = SDL_GetPerformanceFrequency();
+	pacer->last = pacer->start = pacer->last_tick =
+		SDL_GetPerformanceCounter();
+}
+
+int pacer_tick(Pacer *pacer)
+{
+	unsigned long long now = accumulate(pacer);
+	long long step = (long long)pacer->frequency;
+	long long owed = pacer->accumulator / step;
+
+	if (owed > PACER_MAX_BEHIND)
+	{
+		pacer->dropped += owed - PACER_MAX_BEHIND;
+		pacer->accumulator -= (owed - PACER_MAX_BEHIND) * step;
+	}
+
+	if (pacer->accumulator < step)
+	{
+		return false;
+	}
+
+	pacer->accumulator -= step;
+
+	if (pacer->ticks)
+	{
+		pacer->intervals[pacer->ticks & (PACER_INTERVALS - 1)] =
+			(float)((now - pacer->last_tick) * 1000.0 / pacer->frequency);
+	}
+
+	pacer->last_tick = now;
+	pacer->ticks++;
+
+	return true;
+}
+
+double pacer_ms_to_tick(Pacer *pacer)
+{
+	accumulate(pacer);
+
+	long long left = (long long)pacer->frequency - pacer->accumulator;
+
+	return left > 0
+		? left * 1000.0 / ((double)pacer->frequency * pacer->hz)
+		: 0;
+}
+
+void pacer_wait(Pacer *pacer)
+{
+	double ms;
+
+	while ((ms = pacer_ms_to_tick(pacer)) > 0)
+	{
+		if (ms > PACER_SPIN_MS)
+		{
+			SDL_Delay((Uint32)(ms - PACER_SPIN_MS));
+		}
+	}
+}
+
+double pacer_alpha(Pacer const *pacer)
+{
+	double alpha = (double)pacer->accumulator / pacer->frequency;
+
+	return alpha < 0 ? 0 : alpha > 1 ? 1 : alpha;
+}
+
+double pacer_alpha_since(
+	Pacer const *pacer,
+	unsigned long long tick,
+	unsigned long long now)
+{
+	if (now <= tick)
+	{
+		return 0;
+	}
+
+	double alpha = (double)(now - tick) * pacer->hz / pacer->frequency;
+
+	return alpha > 1 ? 1 : alpha;
+}
+
+void pacer_delay(Pacer *pacer, double ms)
+{
+	pacer->accumulator -=
+		(long long)(ms * pacer->frequency * pacer->hz / 1000);
+}
+
+void pacer_stats(Pacer const *pacer, PacerStats *stats)
+{
+	SDL_memset(stats, 0, sizeof(*stats));
+
+	stats->ticks = pacer->ticks;
+	stats->dropped = pacer->dropped;
+
+	if (pacer->last_tick > pacer->start)
+	{
+		stats->hz = pacer->ticks * (double)pacer->frequency /
+			(pacer->last_tick - pacer->start);
+	}
+
+	long long n = pacer->ticks - 1;
+	n = n > PACER_INTERVALS ? PACER_INTERVALS : n;
+
+	if (n <= 0)
+	{
+		return;
+	}
+
+	double sum = 0, squares = 0;
+	stats->min_ms = stats->max_ms = pacer->intervals[
+		(pacer->ticks - 1) & (PACER_INTERVALS - 1)];
+
+	for (long long i = 0; i < n; i++)
+	{
+		double interval =
+			pacer->intervals[(pacer->ticks - 1 - i) & (PACER_INTERVALS - 1)];
+
+		sum += interval;
+		squares += interval * interval;
+		stats->min_ms = interval < stats->min_ms ? interval : stats->min_ms;
+		stats->max_ms = interval > stats->max_ms ? interval : stats->max_ms;
+	}
+
+	double variance = squares / n - (sum / n) * (sum / n);
+
+	stats->mean_ms = sum / n;
+	stats->jitter_ms = variance > 0 ? sqrt(variance) : 0;
+}
@@ -0,0 +1,79 @@
+#ifndef _PACER_H_
+#define _PACER_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Tick intervals kept for jitter. Must be a power of two.
+#define PACER_INTERVALS  128
+
+// Waiting sleeps until this close to a tick, then spins, as sleeps overshoot.
+#define PACER_SPIN_MS    2
+
+// Ticks owed past this many are dropped rather than run back to back, after
+// a stall such as the window being dragged.
+#define PACER_MAX_BEHIND 4
+
+// Ticks at a fixed rate off SDL's performance counter. Time passed goes into
+// an accumulator, a tick is due for every whole step in it, and what is left
+// carries over, so the rate doesn't drift.
+typedef struct Pacer
+{
+	int hz;
+	unsigned long long frequency;
+	unsigned long long last;
+	// In counter ticks times hz, so that a step is exactly frequency.
+	long long accumulator;
+
+	unsigned long long start;
+	unsigned long long last_tick;
+	long long ticks;
+	long long dropped;
+	float intervals[PACER_INTERVALS];
+} Pacer;
+
+// Interval stats over the last PACER_INTERVALS ticks, in milliseconds, and
+// the rate since the start.
+typedef struct PacerStats
+{
+	double hz;
+	double mean_ms;
+	double jitter_ms;
+	double min_ms;
+	double max_ms;
+	long long ticks;
+	long long dropped;
+} PacerStats;
+
+void pacer_start(Pacer *pacer, int hz);
+
+// Returns true when a tick is due, and takes it out of the accumulator.
+int pacer_tick(Pacer *pacer);
+
+// Sleeps, then spins, until a tick is due.
+void pacer_wait(Pacer *pacer);
+
+// Milliseconds until a tick is due, 0 if one is.
+double pacer_ms_to_tick(Pacer *pacer);
+
+// How far into the next step the time is, from 0 to 1.
+double pacer_alpha(Pacer const *pacer);
+
+// Likewise, for the step after a tick at counter tick. Only reads what
+// pacer_start sets, so other threads can call it.
+double pacer_alpha_since(
+	Pacer const *pacer,
+	unsigned long long tick,
+	unsigned long long now);
+
+// Puts the next tick off by ms.
+void pacer_delay(Pacer *pacer, double ms);
+
+void pacer_stats(Pacer const *pacer, PacerStats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ifndef _PACER_H_
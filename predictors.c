@@ -0,0 +1,306 @@
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "predictors.h"
+
+// Run lengths in buckets of 0, 1, 2, 3 to 4, 5 to 8 and so on, the last
+// counting anything from 33 up.
+#define RUN_BUCKETS 8
+
+// By value, run bucket and previous run bucket.
+#define CONTEXTS (2 * RUN_BUCKETS * RUN_BUCKETS)
+
+static int get_bit(void const *input, int bit)
+{
+	return ((unsigned char const*)input)[bit >> 3] >> (bit & 7) & 1;
+}
+
+static void set_bit(void *input, int bit, int value)
+{
+	unsigned char *byte = (unsigned char*)input + (bit >> 3);
+	*byte = (unsigned char)((*byte & ~(1 << (bit & 7))) | value << (bit & 7));
+}
+
+static int run_bucket(int run)
+{
+	if (run < 3)
+	{
+		return run;
+	}
+
+	int bucket = 3;
+
+	while (bucket < RUN_BUCKETS - 1 && run > 1 << (bucket - 1))
+	{
+		bucket++;
+	}
+
+	return bucket;
+}
+
+int hold_predictor_create(
+	HoldPredictor *predictor, int num_players, int input_size)
+{
+	int num_bits = input_size * 8;
+
+	memset(predictor, 0, sizeof(*predictor));
+
+	predictor->num_players = num_players;
+	predictor->num_bits = num_bits;
+	predictor->values = (unsigned char*)calloc(num_players * num_bits, 1);
+	predictor->runs = (int*)calloc(num_players * num_bits, sizeof(int));
+	predictor->lengths = (int*)calloc(
+		num_bits * 2 * HOLD_PREDICTOR_MAX_RUN, sizeof(int));
+
+	if (!predictor->values || !predictor->runs || !predictor->lengths)
+	{
+		hold_predictor_destroy(predictor);
+		return false;
+	}
+
+	return true;
+}
+
+void hold_predictor_destroy(HoldPredictor *predictor)
+{
+	free(predictor->values);
+	free(predictor->runs);
+	free(predictor->lengths);
+	memset(predictor, 0, sizeof(*predictor));
+}
+
+static void hold_observe(void *context, int player, void const *input)
+{
+	HoldPredictor *predictor = (HoldPredictor*)context;
+	int first = player * predictor->num_bits;
+
+	for (int b = 0; b < predictor->num_bits; b++)
+	{
+		int value = get_bit(input, b);
+		int *run = predictor->runs + first + b;
+		unsigned char *last = predictor->values + first + b;
+
+		if (*run && value == *last)
+		{
+			(*run)++;
+			continue;
+		}
+
+		if (*run)
+		{
+			int length = *run < HOLD_PREDICTOR_MAX_RUN
+				? *run
+				: HOLD_PREDICTOR_MAX_RUN - 1;
+
+			predictor->lengths[(b * 2 + *last) * HOLD_PREDICTOR_MAX_RUN +
+				length]++;
+		}
+
+		*last = (unsigned char)value;
+		*run = 1;
+	}
+}
+
+// Runs of the value that lasted at least the given frames.
+static int runs_at_least(int const *lengths, int frames)
+{
+	int count = 0;
+
+	frames = frames < HOLD_PREDICTOR_MAX_RUN
+		? frames
+		: HOLD_PREDICTOR_MAX_RUN - 1;
+
+	for (int n = frames; n < HOLD_PREDICTOR_MAX_RUN; n++)
+	{
+		count += lengths[n];
+	}
+
+	return count;
+}
+
+static void hold_predict(
+	void *context,
+	int player,
+	void const *last_input,
+	int frames_ahead,
+	void *input)
+{
+	HoldPredictor *predictor = (HoldPredictor*)context;
+	int first = player * predictor->num_bits;
+
+	memcpy(input, last_input, predictor->num_bits / 8);
+
+	for (int b = 0; b < predictor->num_bits; b++)
+	{
+		int run = predictor->runs[first + b];
+		int value = predictor->values[first + b];
+		int const *lengths = predictor->lengths +
+			(b * 2 + value) * HOLD_PREDICTOR_MAX_RUN;
+		int lasted = runs_at_least(lengths, run);
+
+		// Flipped once most runs that lasted this long are over by then.
+		if (lasted &&
+			2 * runs_at_least(lengths, run + frames_ahead) < lasted)
+		{
+			set_bit(input, b, !value);
+		}
+	}
+}
+
+RollbackPredictor hold_predictor_interface(HoldPredictor *predictor)
+{
+	RollbackPredictor interface;
+
+	interface.name = "hold";
+	interface.context = predictor;
+	interface.observe = hold_observe;
+	interface.predict = hold_predict;
+
+	return interface;
+}
+
+int learned_predictor_create(
+	LearnedPredictor *predictor, int num_players, int input_size)
+{
+	int num_bits = input_size * 8;
+	int count = num_players * num_bits;
+
+	memset(predictor, 0, sizeof(*predictor));
+
+	predictor->num_players = num_players;
+	predictor->num_bits = num_bits;
+	predictor->values = (unsigned char*)calloc(count, 1);
+	predictor->runs = (int*)calloc(count, sizeof(int));
+	predictor->previous_runs = (int*)calloc(count, sizeof(int));
+	predictor->seen = (unsigned char*)calloc(num_players, 1);
+	predictor->counts = (unsigned short*)calloc(
+		count * CONTEXTS * 2, sizeof(unsigned short));
+
+	if (!predictor->values ||
+		!predictor->runs ||
+		!predictor->previous_runs ||
+		!predictor->seen ||
+		!predictor->counts)
+	{
+		learned_predictor_destroy(predictor);
+		return false;
+	}
+
+	return true;
+}
+
+void learned_predictor_destroy(LearnedPredictor *predictor)
+{
+	free(predictor->values);
+	free(predictor->runs);
+	free(predictor->previous_runs);
+	free(predictor->seen);
+	free(predictor->counts);
+	memset(predictor, 0, sizeof(*predictor));
+}
+
+static int context_of(int value, int run, int previous_run)
+{
+	return (value * RUN_BUCKETS + run_bucket(run)) * RUN_BUCKETS +
+		run_bucket(previous_run);
+}
+
+static void learned_observe(void *context, int player, void const *input)
+{
+	LearnedPredictor *predictor = (LearnedPredictor*)context;
+	int first = player * predictor->num_bits;
+
+	for (int b = 0; b < predictor->num_bits; b++)
+	{
+		int i = first + b;
+		int value = get_bit(input, b);
+
+		if (!predictor->seen[player])
+		{
+			predictor->values[i] = (unsigned char)value;
+			predictor->runs[i] = 1;
+			continue;
+		}
+
+		int ended = value != predictor->values[i];
+		unsigned short *counts = predictor->counts + (i * CONTEXTS +
+			context_of(predictor->values[i],
+				predictor->runs[i],
+				predictor->previous_runs[i])) * 2;
+
+		// Halved when full, which also forgets old habits.
+		if (counts[ended] == 0xffff)
+		{
+			counts[0] >>= 1;
+			counts[1] >>= 1;
+		}
+
+		counts[ended]++;
+
+		if (ended)
+		{
+			predictor->previous_runs[i] = predictor->runs[i];
+			predictor->values[i] = (unsigned char)value;
+			predictor->runs[i] = 1;
+		}
+		else
+		{
+			predictor->runs[i]++;
+		}
+	}
+
+	predictor->seen[player] = true;
+}
+
+static void learned_predict(
+	void *context,
+	int player,
+	void const *last_input,
+	int frames_ahead,
+	void *input)
+{
+	LearnedPredictor *predictor = (LearnedPredictor*)context;
+	int first = player * predictor->num_bits;
+
+	memcpy(input, last_input, predictor->num_bits / 8);
+
+	for (int b = 0; b < predictor->num_bits; b++)
+	{
+		int i = first + b;
+		int value = predictor->values[i];
+		int run = predictor->runs[i];
+		int previous_run = predictor->previous_runs[i];
+
+		// Plays the most likely frame after frame forward.
+		for (int f = 0; f < frames_ahead; f++)
+		{
+			unsigned short const *counts = predictor->counts +
+				(i * CONTEXTS + context_of(value, run, previous_run)) * 2;
+
+			if (counts[1] > counts[0])
+			{
+				previous_run = run;
+				value = !value;
+				run = 1;
+			}
+			else
+			{
+				run++;
+			}
+		}
+
+		set_bit(input, b, value);
+	}
+}
+
+RollbackPredictor learned_predictor_interface(LearnedPredictor *predictor)
+{
+	RollbackPredictor interface;
+
+	interface.name = "learned";
+	interface.context = predictor;
+	interface.observe = learned_observe;
+	interface.predict = learned_predict;
+
+	return interface;
+}
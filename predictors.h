@@ -0,0 +1,69 @@
+#ifndef _PREDICTORS_H_
+#define _PREDICTORS_H_
+
+#include "rollback.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Predictors for inputs that are bitmasks of buttons held down, such as
+// those of enum INPUT, which model every bit on its own. A bit is expected to
+// keep its value for as long as runs of that value tend to last, rather than
+// forever, so that a tapped button is guessed released and a held one held.
+
+#define HOLD_PREDICTOR_MAX_RUN 64
+
+// Learns how long each bit tends to stay set or clear from every player at
+// once.
+typedef struct HoldPredictor
+{
+	int num_players;
+	int num_bits;
+	// By player and bit, the value and for how many frames it has had it.
+	unsigned char *values;
+	int *runs;
+	// By bit and value, how many runs lasted n frames, the last counting
+	// anything longer.
+	int *lengths;
+} HoldPredictor;
+
+int hold_predictor_create(
+	HoldPredictor *predictor,
+	int num_players,
+	int input_size);
+
+void hold_predictor_destroy(HoldPredictor *predictor);
+
+RollbackPredictor hold_predictor_interface(HoldPredictor *predictor);
+
+// Learns, for each player and bit, whether a run of a value ends given how
+// long it has lasted and how long the run before it lasted, so it picks up
+// rhythms such as firing every few frames.
+typedef struct LearnedPredictor
+{
+	int num_players;
+	int num_bits;
+	// By player and bit.
+	unsigned char *values;
+	int *runs;
+	int *previous_runs;
+	unsigned char *seen;
+	// By player, bit and context, how often the run went on and ended.
+	unsigned short *counts;
+} LearnedPredictor;
+
+int learned_predictor_create(
+	LearnedPredictor *predictor,
+	int num_players,
+	int input_size);
+
+void learned_predictor_destroy(LearnedPredictor *predictor);
+
+RollbackPredictor learned_predictor_interface(LearnedPredictor *predictor);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ifndef _PREDICTORS_H_
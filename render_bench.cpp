@@ -0,0 +1,283 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench_input.h"
+#include "connection_report.h"
+#include "game.h"
+#include "game_state.h"
+#include "hud_text.h"
+#include "offscreen.h"
+#include "renderer.h"
+#include "timer.h"
+
+// Records a run of the simulation, then draws every frame of it offscreen,
+// overlay and all, and reports how long frames took to render. Needs no
+// display or GL, so that rendering can be measured anywhere.
+
+#define ARENA_WIDTH  640
+#define ARENA_HEIGHT 480
+
+typedef struct BenchOptions
+{
+	int frames;
+	int num_ships;
+	int max_bullets;
+	enum RENDERER_BACKEND backend;
+	bool trig;
+	char const *dump;
+	int dump_every;
+} BenchOptions;
+
+static void show_syntax()
+{
+	fprintf(stderr,
+		"Syntax: render_bench [--frames n] [--ships n] [--bullets n]\n"
+		"                     [--backend immediate|batched|unified] [--trig]\n"
+		"                     [--dump prefix] [--dump-every n]\n");
+}
+
+static int parse_args(int argc, char *args[], BenchOptions *options)
+{
+	options->frames = 600;
+	options->num_ships = 4;
+	options->max_bullets = DEFAULT_MAX_BULLETS;
+	options->backend = RENDERER_BACKEND_batched;
+	options->trig = false;
+	options->dump = NULL;
+	options->dump_every = 60;
+
+	for (int i = 1; i < argc; i++)
+	{
+		char const *value = i + 1 < argc ? args[i + 1] : NULL;
+
+		if (!strcmp(args[i], "--trig"))
+		{
+			options->trig = true;
+			continue;
+		}
+
+		if (!value)
+		{
+			return false;
+		}
+
+		if (!strcmp(args[i], "--frames"))
+		{
+			options->frames = atoi(value);
+		}
+		else if (!strcmp(args[i], "--ships"))
+		{
+			options->num_ships = atoi(value);
+		}
+		else if (!strcmp(args[i], "--bullets"))
+		{
+			options->max_bullets = atoi(value);
+		}
+		else if (!strcmp(args[i], "--backend"))
+		{
+			if (!strcmp(value, "immediate"))
+			{
+				options->backend = RENDERER_BACKEND_immediate;
+			}
+			else if (!strcmp(value, "batched"))
+			{
+				options->backend = RENDERER_BACKEND_batched;
+			}
+			else if (!strcmp(value, "unified"))
+			{
+				options->backend = RENDERER_BACKEND_unified;
+			}
+			else
+			{
+				return false;
+			}
+		}
+		else if (!strcmp(args[i], "--dump"))
+		{
+			options->dump = value;
+		}
+		else if (!strcmp(args[i], "--dump-every"))
+		{
+			options->dump_every = atoi(value);
+		}
+		else
+		{
+			return false;
+		}
+
+		i++;
+	}
+
+	return options->frames > 0 &&
+		options->num_ships > 0 &&
+		options->max_bullets > 0 &&
+		options->dump_every > 0;
+}
+
+static int compare_doubles(void const *a, void const *b)
+{
+	double x = *(double const*)a;
+	double y = *(double const*)b;
+
+	return (x > y) - (x < y);
+}
+
+// Every frame of the run, one game state after another.
+static unsigned char *record(BenchOptions const *options, int *state_size)
+{
+	LocalInput *inputs =
+		(LocalInput*)calloc(options->num_ships, sizeof(LocalInput));
+
+	if (!inputs || !setup_game(
+		ARENA_WIDTH, ARENA_HEIGHT, options->num_ships, options->max_bullets))
+	{
+		free(inputs);
+		return NULL;
+	}
+
+	*state_size = game_state()->size;
+
+	unsigned char *states =
+		(unsigned char*)malloc((size_t)*state_size * options->frames);
+
+	for (int frame = 0; states && frame < options->frames; frame++)
+	{
+		for (int i = 0; i < options->num_ships; i++)
+		{
+			inputs[i].inputs = scripted_input(frame, i);
+		}
+
+		step_game(inputs, 0);
+		memcpy(states + (size_t)*state_size * frame, game_state(), *state_size);
+	}
+
+	tear_down_game();
+	free(inputs);
+
+	return states;
+}
+
+int main(int argc, char *args[])
+{
+	BenchOptions options;
+
+	if (!parse_args(argc, args, &options))
+	{
+		show_syntax();
+		return 1;
+	}
+
+	int state_size;
+	unsigned char *states = record(&options, &state_size);
+	double *times = (double*)malloc(sizeof(double) * options.frames);
+
+	if (!states || !times)
+	{
+		fprintf(stderr, "Out of memory.\n");
+		return 1;
+	}
+
+	Offscreen offscreen;
+
+	if (!offscreen_create(&offscreen, ARENA_WIDTH, ARENA_HEIGHT))
+	{
+		fprintf(stderr, "Can't create the offscreen renderer.\n");
+		return 1;
+	}
+
+	renderer_set_backend(options.backend);
+	renderer_use_silhouettes(!options.trig);
+
+	ConnectionReport connection_report;
+	memset(&connection_report, 0, sizeof(connection_report));
+
+	long long draw_calls = 0, vertices = 0, triangles = 0;
+	double draw_ns = 0, raster_ns = 0;
+	RendererStats stats;
+	HudTextStats hud, hud_total;
+	int dumped = 0;
+
+	memset(&hud_total, 0, sizeof(hud_total));
+
+	for (int frame = 0; frame < options.frames; frame++)
+	{
+		GameState const *gs =
+			(GameState const*)(states + (size_t)state_size * frame);
+		long long start = timer_ticks();
+
+		offscreen_draw(&offscreen, gs, &connection_report);
+
+		times[frame] = timer_ticks_to_ns(timer_ticks() - start) / 1e6;
+
+		renderer_stats(&stats);
+		draw_calls += stats.draw_calls;
+		vertices += stats.vertices;
+		triangles += offscreen.triangles;
+		draw_ns += offscreen.draw_ns;
+		raster_ns += offscreen.raster_ns;
+
+		hud_text_stats(&hud);
+		hud_total.formatted += hud.formatted;
+		hud_total.measured += hud.measured;
+		hud_total.formats_saved += hud.formats_saved;
+		hud_total.measures_saved += hud.measures_saved;
+
+		if (options.dump && frame % options.dump_every == 0)
+		{
+			char filename[1024];
+			snprintf(filename, sizeof filename,
+				"%s%05d.bmp", options.dump, frame);
+
+			if (!offscreen_save(&offscreen, filename))
+			{
+				fprintf(stderr, "Can't write %s.\n", filename);
+				return 1;
+			}
+
+			dumped++;
+		}
+	}
+
+	double total = 0;
+
+	for (int i = 0; i < options.frames; i++)
+	{
+		total += times[i];
+	}
+
+	qsort(times, options.frames, sizeof(double), compare_doubles);
+
+	int n = options.frames;
+
+	printf("ships:       %d x %d bullets\n",
+		options.num_ships, options.max_bullets);
+	static char const *const backends[] = { "immediate", "batched", "unified" };
+
+	printf("backend:     %s, %s\n",
+		backends[options.backend],
+		options.trig ? "trig" : "silhouettes");
+	printf("frames:      %d, %d dumped\n", n, dumped);
+	printf("ms/frame:    %.3f mean, %.3f median, %.3f p99, %.3f max\n",
+		total / n, times[n / 2], times[n - 1 - n / 100], times[n - 1]);
+	printf("draw:        %.3f ms/frame, %.1f ns/ship\n",
+		draw_ns / 1e6 / n, draw_ns / n / options.num_ships);
+	printf("raster:      %.3f ms/frame\n", raster_ns / 1e6 / n);
+	printf("draw calls:  %.1f/frame\n", (double)draw_calls / n);
+	printf("vertices:    %.1f/frame batched\n", (double)vertices / n);
+	printf("triangles:   %.1f/frame rasterized\n", (double)triangles / n);
+	printf("hud text:    %.2f formats and %.2f measures/frame, "
+		"%.2f and %.2f saved\n",
+		(double)hud_total.formatted / n,
+		(double)hud_total.measured / n,
+		(double)hud_total.formats_saved / n,
+		(double)hud_total.measures_saved / n);
+	printf("headings:    %d silhouettes built\n", stats.silhouette_headings);
+
+	renderer_tear_down();
+	offscreen_destroy(&offscreen);
+	free(times);
+	free(states);
+
+	return 0;
+}
@@ -1,11 +1,14 @@
 #include <imgui.h>
 #include <SDL.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <math.h>
 #include "game_state.h"
 #include "connection_report.h"
+#include "hud_text.h"
 #include "renderer.h"
+#include "silhouette.h"
 #include "utils.h"
 
 #define  PROGRESS_BAR_WIDTH        100
@@ -26,6 +29,27 @@ SDL_Color ship_colors[4] =
 	{ 128, 128, 128, SDL_ALPHA_OPAQUE },
 };
 
+// The outline, pointing along the x axis, closed by its last point.
+static SilhouettePoint const ship_shape[] =
+{
+	{  SHIP_RADIUS,             0 },
+	{ -SHIP_RADIUS,             SHIP_WIDTH },
+	{  SHIP_TUCK - SHIP_RADIUS, 0 },
+	{ -SHIP_RADIUS,            -SHIP_WIDTH },
+	{  SHIP_RADIUS,             0 },
+};
+
+static Silhouette ship_silhouette;
+static bool use_silhouettes = true;
+
+// A line of text per ship, kept between frames.
+static HudText *score_texts;
+static int num_score_texts;
+static HudText status_texts[MAX_PARTICIPANTS];
+
+static enum RENDERER_BACKEND backend = RENDERER_BACKEND_batched;
+static RendererStats stats;
+
 SDL_Color black = { 0, 0, 0, SDL_ALPHA_OPAQUE };
 SDL_Color grey = { 128, 128, 128, SDL_ALPHA_OPAQUE };
 SDL_Color white = { 255, 255, 255, SDL_ALPHA_OPAQUE };
@@ -37,55 +61,247 @@ static void set_draw_color(SDL_Renderer *renderer, SDL_Color color)
 	SDL_SetRenderDrawColor(renderer, color.r, color.g, color.b, color.a);
 }
 
-void draw_ship(SDL_Renderer *renderer, int which, GameState const *gs)
+// Through SDL_Renderer, or into the batch with the unified backend, covering
+// the same pixels either way.
+static void draw_rect(
+	SDL_Renderer *renderer, SDL_Rect const *rect, SDL_Color color, bool fill)
 {
-	Ship const *ship = gs->ships + which;
-	SDL_Color c = ship_colors[which];
+	if (backend != RENDERER_BACKEND_unified)
+	{
+		set_draw_color(renderer, color);
+
+		if (fill)
+		{
+			SDL_RenderFillRect(renderer, rect);
+		}
+		else
+		{
+			SDL_RenderDrawRect(renderer, rect);
+		}
 
-	SDL_Point shape[] =
+		stats.draw_calls++;
+		return;
+	}
+
+	if (rect->w <= 0 || rect->h <= 0)
 	{
-		{  SHIP_RADIUS,             0 },
-		{ -SHIP_RADIUS,             SHIP_WIDTH },
-		{  SHIP_TUCK - SHIP_RADIUS, 0 },
-		{ -SHIP_RADIUS,            -SHIP_WIDTH },
-		{  SHIP_RADIUS,             0 },
-	};
+		return;
+	}
 
-	for (int i = 0; i < COUNT_OF(shape); i++)
+	ImDrawList *list = ImGui::GetBackgroundDrawList();
+	ImU32 col = IM_COL32(color.r, color.g, color.b, color.a);
+	float x0 = (float)rect->x;
+	float y0 = (float)rect->y;
+	float x1 = x0 + rect->w;
+	float y1 = y0 + rect->h;
+
+	if (fill || rect->w <= 2 || rect->h <= 2)
+	{
+		list->PrimReserve(6, 4);
+		list->PrimRect(ImVec2(x0, y0), ImVec2(x1, y1), col);
+		stats.vertices += 4;
+		return;
+	}
+
+	list->PrimReserve(4 * 6, 4 * 4);
+	list->PrimRect(ImVec2(x0, y0), ImVec2(x1, y0 + 1), col);
+	list->PrimRect(ImVec2(x0, y1 - 1), ImVec2(x1, y1), col);
+	list->PrimRect(ImVec2(x0, y0 + 1), ImVec2(x0 + 1, y1 - 1), col);
+	list->PrimRect(ImVec2(x1 - 1, y0 + 1), ImVec2(x1, y1 - 1), col);
+	stats.vertices += 4 * 4;
+}
+
+// The outline of a ship, put at x, y. Rotated by trig every time when
+// silhouettes are off, or can't be allocated.
+static void ship_outline(Ship const *ship, float x, float y, ImVec2 *shape)
+{
+	if (use_silhouettes && !ship_silhouette.rotations)
+	{
+		silhouette_create(
+			&ship_silhouette, ship_shape, COUNT_OF(ship_shape));
+	}
+
+	if (use_silhouettes && ship_silhouette.rotations)
+	{
+		SilhouettePoint const *rotated =
+			silhouette_at(&ship_silhouette, ship->heading);
+
+		for (int i = 0; i < COUNT_OF(ship_shape); i++)
+		{
+			shape[i] = ImVec2(rotated[i].x + x, rotated[i].y + y);
+		}
+
+		return;
+	}
+
+	double theta = (double)ship->heading * PI / 180;
+	double cost = ::cos(theta);
+	double sint = ::sin(theta);
+
+	for (int i = 0; i < COUNT_OF(ship_shape); i++)
 	{
-		double newx, newy;
-		double cost, sint, theta;
+		shape[i] = ImVec2(
+			(float)(ship_shape[i].x * cost - ship_shape[i].y * sint) + x,
+			(float)(ship_shape[i].x * sint + ship_shape[i].y * cost) + y);
+	}
+}
 
-		theta = (double)ship->heading * PI / 180;
-		cost = ::cos(theta);
-		sint = ::sin(theta);
+// The first ships keep their colors, the rest are spread around the hue circle
+// by the golden angle.
+static SDL_Color ship_color(int which)
+{
+	if (which < COUNT_OF(ship_colors))
+	{
+		return ship_colors[which];
+	}
 
-		newx = shape[i].x * cost - shape[i].y * sint;
-		newy = shape[i].x * sint + shape[i].y * cost;
+	int hue = (which * 137) % 360;
+	Uint8 x = (Uint8)(255 * (60 - abs(hue % 120 - 60)) / 60);
 
-		shape[i].x = (int)(newx + ship->position.x);
-		shape[i].y = (int)(newy + ship->position.y);
+	switch (hue / 60)
+	{
+	case 0: return { 255, x, 0, SDL_ALPHA_OPAQUE };
+	case 1: return { x, 255, 0, SDL_ALPHA_OPAQUE };
+	case 2: return { 0, 255, x, SDL_ALPHA_OPAQUE };
+	case 3: return { 0, x, 255, SDL_ALPHA_OPAQUE };
+	case 4: return { x, 0, 255, SDL_ALPHA_OPAQUE };
+	default: return { 255, 0, x, SDL_ALPHA_OPAQUE };
 	}
+}
+
+static void draw_ship(SDL_Renderer *renderer, int which, GameState const *gs)
+{
+	Ship const *ship = game_state_ships(gs) + which;
+	ImVec2 outline[COUNT_OF(ship_shape)];
+	SDL_Point shape[COUNT_OF(ship_shape)];
 
-	set_draw_color(renderer, c);
-	SDL_RenderDrawLines(renderer, shape, 5);
+	ship_outline(
+		ship,
+		(float)scalar_to_double(ship->position.x),
+		(float)scalar_to_double(ship->position.y),
+		outline);
 
-	for (int i = 0; i < MAX_BULLETS; i++)
+	for (int i = 0; i < COUNT_OF(shape); i++)
 	{
-		if (ship->bullets[i].active)
+		shape[i].x = (int)outline[i].x;
+		shape[i].y = (int)outline[i].y;
+	}
+
+	set_draw_color(renderer, ship_color(which));
+	SDL_RenderDrawLines(renderer, shape, COUNT_OF(shape));
+	stats.draw_calls++;
+
+	Bullets bullets = game_state_bullets(gs);
+	int first = which * gs->max_bullets;
+
+	for (int i = first; i < first + gs->max_bullets; i++)
+	{
+		if (bullet_is_active(&bullets, i))
 		{
 			SDL_Rect rect =
 			{
-				(int)ship->bullets[i].position.x - 1,
-				(int)ship->bullets[i].position.y - 1,
+				(int)scalar_to_double(bullets.x[i]) - 1,
+				(int)scalar_to_double(bullets.y[i]) - 1,
 				2,
 				2
 			};
 
 			set_draw_color(renderer, safety_yellow);
 			SDL_RenderFillRect(renderer, &rect);
+			stats.draw_calls++;
 		}
 	}
+}
+
+// A line a pixel wide as a quad, stretched by half a pixel at either end so
+// that the joins of an outline are closed.
+static void batch_line(
+	ImDrawList *list, ImVec2 a, ImVec2 b, ImVec2 uv, ImU32 col)
+{
+	float dx = b.x - a.x;
+	float dy = b.y - a.y;
+	float length = sqrtf(dx * dx + dy * dy);
+
+	if (length > 0)
+	{
+		dx *= 0.5f / length;
+		dy *= 0.5f / length;
+	}
+	else
+	{
+		dx = 0.5f;
+	}
+
+	list->PrimQuadUV(
+		ImVec2(a.x - dx - dy, a.y - dy + dx),
+		ImVec2(b.x + dx - dy, b.y + dy + dx),
+		ImVec2(b.x + dx + dy, b.y + dy - dx),
+		ImVec2(a.x - dx + dy, a.y - dy - dx),
+		uv, uv, uv, uv,
+		col);
+}
+
+// Every ship outline and bullet goes into the background draw list, which is
+// one vertex buffer drawn with a single call however many there are.
+static void batch_ships(GameState const *gs)
+{
+	ImDrawList *list = ImGui::GetBackgroundDrawList();
+	ImVec2 uv = ImGui::GetFontTexUvWhitePixel();
+	Ship const *ships = game_state_ships(gs);
+	Bullets bullets = game_state_bullets(gs);
+	int segments = COUNT_OF(ship_shape) - 1;
+	int num_bullets = gs->num_ships * gs->max_bullets;
+	int reserved = gs->num_ships * segments + num_bullets;
+	int quads = 0;
+
+	list->PrimReserve(reserved * 6, reserved * 4);
+
+	for (int i = 0; i < gs->num_ships; i++)
+	{
+		SDL_Color c = ship_color(i);
+		ImU32 col = IM_COL32(c.r, c.g, c.b, c.a);
+		// To the centres of the pixels, as SDL draws.
+		float x = (float)scalar_to_double(ships[i].position.x) + 0.5f;
+		float y = (float)scalar_to_double(ships[i].position.y) + 0.5f;
+		ImVec2 shape[COUNT_OF(ship_shape)];
+
+		ship_outline(&ships[i], x, y, shape);
+
+		for (int j = 0; j < segments; j++)
+		{
+			batch_line(list, shape[j], shape[j + 1], uv, col);
+		}
+
+		quads += segments;
+	}
+
+	ImU32 bullet_col = IM_COL32(
+		safety_yellow.r, safety_yellow.g, safety_yellow.b, safety_yellow.a);
+
+	for (int i = 0; i < num_bullets; i++)
+	{
+		if (bullet_is_active(&bullets, i))
+		{
+			float x = (float)scalar_to_double(bullets.x[i]);
+			float y = (float)scalar_to_double(bullets.y[i]);
+
+			list->PrimRect(
+				ImVec2(x - 1, y - 1), ImVec2(x + 1, y + 1), bullet_col);
+
+			quads++;
+		}
+	}
+
+	list->PrimUnreserve((reserved - quads) * 6, (reserved - quads) * 4);
+
+	stats.draw_calls++;
+	stats.vertices += quads * 4;
+}
+
+static void draw_score(int which, GameState const *gs)
+{
+	Ship const *ship = game_state_ships(gs) + which;
+	SDL_Color c = ship_color(which);
 
 	SDL_Point text_offsets[] = 
 	{
@@ -95,67 +311,70 @@ void draw_ship(SDL_Renderer *renderer, int which, GameState const *gs)
 		{ gs->bounds.right - 2, gs->bounds.bottom - 2 },
 	};
 
-	char buf[32];
-	sprintf_s(buf, sizeof buf, "Hits: %d", ship->score);
-
-	ImVec2 text_size = ImGui::CalcTextSize(buf);
+	HudText const *score =
+		hud_text_format(score_texts + which, "Hits: %d", ship->score, 0);
+	ImVec2 text_size(score->width, score->height);
 
 	int ya[] = { 0, 0, -1, -1 };
 	int xa[] = { 0, -1, 0, -1 };
 
+	// Past four ships, stack further scores away from the corners.
+	int corner = which % 4;
+	int row = which / 4;
+	float stack = text_size.y * row * (ya[corner] ? -1 : 1);
+
 	ImGui::GetBackgroundDrawList()->AddText(
 		ImVec2(
-			text_offsets[which].x + text_size.x * xa[which],
-			text_offsets[which].y + text_size.y * ya[which]),
+			text_offsets[corner].x + text_size.x * xa[corner],
+			text_offsets[corner].y + text_size.y * ya[corner] + stack),
 		IM_COL32(c.r, c.g, c.b, c.a),
-		buf);
+		score->text);
 }
 
 void draw_connect_state(
-	SDL_Renderer *renderer, Ship const *ship, ConnectionInfo const *info)
+	SDL_Renderer *renderer,
+	int which,
+	Ship const *ship,
+	ConnectionInfo const *info)
 {
-	char status[64];
-	*status = '\0';
+	char const *status = NULL;
 	int progress = -1;
 	bool local = info->type == PARTICIPANT_TYPE_local;
 
 	switch (info->state) {
 	case CONNECTION_STATE_connecting:
-		sprintf_s(
-			status, 
-			sizeof status,
-			local ? "Local Player" : "Connecting...");
+		status = local ? "Local Player" : "Connecting...";
 		break;
 
 	case CONNECTION_STATE_synchronizing:
-		sprintf_s(
-			status,
-			sizeof status, 
-			local ? "Local Player" : "Synchronizing...");
+		status = local ? "Local Player" : "Synchronizing...";
 		progress = info->connect_progress;
 		break;
 
 	case CONNECTION_STATE_disconnected:
-		sprintf_s(status, sizeof status, "Disconnected");
+		status = "Disconnected";
 		break;
 
 	case CONNECTION_STATE_disconnecting:
-		sprintf_s(status, sizeof status, "Waiting for player...");
+		status = "Waiting for player...";
 		progress = (SDL_GetTicks() - info->disconnect_start) * 
 			100 / info->disconnect_timeout;
 		break;
 	}
 
-	if (*status)
+	if (status)
 	{
 		ImDrawList* draw_list = ImGui::GetBackgroundDrawList();
+		HudText const *text = hud_text_string(status_texts + which, status);
 
-		float x = (float)(ship->position.x - (double)ImGui::CalcTextSize(status).x / 2);
+		double ship_x = scalar_to_double(ship->position.x);
+		double ship_y = scalar_to_double(ship->position.y);
+		float x = (float)(ship_x - (double)text->width / 2);
 
 		draw_list->AddText(
-			ImVec2(x, (float)(ship->position.y + (double)PROGRESS_TEXT_OFFSET)),
+			ImVec2(x, (float)(ship_y + (double)PROGRESS_TEXT_OFFSET)),
 			IM_COL32_WHITE,
-			status);
+			text->text);
 	}
 	if (progress >= 0)
 	{
@@ -165,27 +384,61 @@ void draw_connect_state(
 
 		SDL_Rect rc = 
 		{ 
-			(int)(ship->position.x - (PROGRESS_BAR_WIDTH / 2)),
-			(int)(ship->position.y + PROGRESS_BAR_TOP_OFFSET),
+			(int)(scalar_to_double(ship->position.x) - (PROGRESS_BAR_WIDTH / 2)),
+			(int)(scalar_to_double(ship->position.y) + PROGRESS_BAR_TOP_OFFSET),
 			(int)PROGRESS_BAR_WIDTH,
 			(int)PROGRESS_BAR_HEIGHT };
 
-		set_draw_color(renderer, grey);
-		SDL_RenderDrawRect(renderer, &rc);
+		draw_rect(renderer, &rc, grey, false);
 
 		rc.w = min(100, progress) * PROGRESS_BAR_WIDTH / 100;
 		rc = { rc.x + 1, rc.y + 1, rc.w - 1, rc.h - 1 };
 
-		set_draw_color(renderer, bar);
-		SDL_RenderFillRect(renderer, &rc);
+		draw_rect(renderer, &rc, bar, true);
 	}
 }
 
+void renderer_set_backend(enum RENDERER_BACKEND which)
+{
+	backend = which;
+}
+
+enum RENDERER_BACKEND renderer_backend(void)
+{
+	return backend;
+}
+
+void renderer_use_silhouettes(int use)
+{
+	use_silhouettes = use;
+}
+
+void renderer_stats(RendererStats *out)
+{
+	*out = stats;
+	out->silhouette_headings = ship_silhouette.headings_built;
+}
+
+void renderer_tear_down(void)
+{
+	silhouette_destroy(&ship_silhouette);
+
+	free(score_texts);
+	score_texts = NULL;
+	num_score_texts = 0;
+}
+
 void draw(
 	SDL_Renderer *renderer, GameState const *gs, ConnectionReport const *cr)
 {
-	set_draw_color(renderer, black);
-	SDL_RenderClear(renderer);
+	memset(&stats, 0, sizeof(stats));
+
+	if (backend != RENDERER_BACKEND_unified)
+	{
+		set_draw_color(renderer, black);
+		SDL_RenderClear(renderer);
+		stats.draw_calls++;
+	}
 
 	SDL_Rect bounds =
 	{
@@ -195,15 +448,48 @@ void draw(
 		gs->bounds.bottom - gs->bounds.top
 	};
 
-	set_draw_color(renderer, white);
-	SDL_RenderDrawRect(renderer, &bounds);
+	draw_rect(renderer, &bounds, white, false);
+
+	Ship const *ships = game_state_ships(gs);
+
+	if (gs->num_ships > num_score_texts)
+	{
+		HudText *grown = (HudText*)realloc(
+			score_texts, sizeof(HudText) * gs->num_ships);
+
+		if (!grown)
+		{
+			return;
+		}
+
+		memset(grown + num_score_texts,
+			0,
+			sizeof(HudText) * (gs->num_ships - num_score_texts));
+
+		score_texts = grown;
+		num_score_texts = gs->num_ships;
+	}
+
+	if (backend != RENDERER_BACKEND_immediate)
+	{
+		batch_ships(gs);
+	}
 
 	for (int i = 0; i < gs->num_ships; i++)
 	{
-		draw_ship(renderer, i, gs);
+		if (backend == RENDERER_BACKEND_immediate)
+		{
+			draw_ship(renderer, i, gs);
+		}
 
-		draw_connect_state(renderer, 
-			&gs->ships[i],
-			&cr->participants[i]);
+		draw_score(i, gs);
+
+		if (i < cr->num_participants)
+		{
+			draw_connect_state(renderer,
+				i,
+				&ships[i],
+				&cr->participants[i]);
+		}
 	}
 }
@@ -5,6 +5,42 @@
 extern "C" {
 #endif
 
+enum RENDERER_BACKEND
+{
+	// A draw call per ship outline and per bullet.
+	RENDERER_BACKEND_immediate,
+	// Every ship outline and bullet in one vertex buffer, drawn by ImGui with
+	// the background draw list in a single draw call.
+	RENDERER_BACKEND_batched,
+	// Likewise, with the arena and progress bars too, so that nothing at all
+	// goes through SDL_Renderer and ImGui's renderer submits the whole frame
+	// in one pass. The caller clears the frame.
+	RENDERER_BACKEND_unified,
+};
+
+// What the last draw took. Vertices only count towards the batch.
+typedef struct RendererStats
+{
+	// SDL_Renderer calls, and one for the batch, if any.
+	int draw_calls;
+	int vertices;
+	// Headings ship outlines have been rotated to and kept, so far.
+	int silhouette_headings;
+} RendererStats;
+
+void renderer_set_backend(enum RENDERER_BACKEND backend);
+
+enum RENDERER_BACKEND renderer_backend(void);
+
+// Ship outlines are looked up by heading, rotated once, unless turned off,
+// when they are rotated by trig for every ship drawn. On by default.
+void renderer_use_silhouettes(int use);
+
+void renderer_stats(RendererStats *stats);
+
+// Frees what drawing built up and kept. Drawing again starts over.
+void renderer_tear_down(void);
+
 void draw(
 	struct SDL_Renderer *renderer,
 	struct GameState const *game_state, 
@@ -0,0 +1,1546 @@
+#include <stdlib.h>
+#include <string.h>
+#include "rollback.h"
+#include "timer.h"
+
+// Far more than can be in flight, as no player gets further ahead of the
+// others than the prediction window and its input delay. A power of two.
+#define INPUT_QUEUE_FRAMES          128
+
+// The current frame and everything a rollback can go back to.
+#define SAVED_STATES                (ROLLBACK_MAX_PREDICTION + 2)
+
+#define SEND_INTERVAL_MS            16
+#define MAX_MESSAGE_FRAMES          64
+
+#define DEFAULT_DISCONNECT_TIMEOUT  5000
+#define DEFAULT_NOTIFY_START        750
+
+// As GGPO does, recommend waiting from the average frame advantage over a
+// window of frames, now and then.
+#define TIMESYNC_WINDOW             40
+#define TIMESYNC_INTERVAL           240
+#define MIN_FRAME_ADVANTAGE         3
+#define MAX_FRAME_ADVANTAGE         9
+
+#define MAX_FRAME_DELAY             (INPUT_QUEUE_FRAMES / 4 - 1)
+
+// Every player proposes an input delay along with each of its inputs. Every
+// DELAY_EPOCH_FRAMES frames, the delay proposed for that frame is agreed on,
+// to take effect once the frame is confirmed on every peer, which it must be
+// before any peer gets past the prediction window.
+#define DELAY_EPOCH_FRAMES          120
+#define DELAY_LEAD_FRAMES           (ROLLBACK_MAX_PREDICTION + 1)
+
+// Adaptive delay leaves the rest of the latency to rollbacks, as deep as
+// this as long as replaying them takes less than the budget.
+#define DELAY_ROLLBACK_FRAMES       3
+#define DELAY_ROLLBACK_BUDGET_NS    4000000.0
+
+// How much lower latency must be to propose less delay, against flapping.
+#define DELAY_HYSTERESIS_MS         4
+
+enum MESSAGE
+{
+	MESSAGE_input = 1,
+};
+
+enum MESSAGE_FLAG
+{
+	MESSAGE_FLAG_echo = 1,
+};
+
+// Every field little endian:
+//   0  type         u8
+//   1  player       u8   the sender's local player
+//   2  input size   u8
+//   3  count        u8   inputs that follow, then a byte each of the
+//                        delay the sender proposed with them
+//   4  flags        u8
+//   8  frame        i32  the sender's current frame
+//   12 advantage    i32  the sender's frame advantage over the receiver
+//   16 ack          i32  the last frame of the receiver's player it has
+//   20 start        i32  the frame of the first input that follows
+//   24 sent         u32  the sender's clock
+//   28 echo         u32  the last sent clock it received from the receiver
+#define MESSAGE_HEADER_SIZE         32
+#define MAX_MESSAGE_SIZE \
+	(MESSAGE_HEADER_SIZE + MAX_MESSAGE_FRAMES * (ROLLBACK_MAX_INPUT_SIZE + 1))
+
+typedef struct Player
+{
+	bool added;
+	GGPOPlayerType type;
+	int peer;
+	int frame_delay;
+
+	// Inputs by frame % INPUT_QUEUE_FRAMES, known up to last_frame.
+	unsigned char inputs[INPUT_QUEUE_FRAMES * ROLLBACK_MAX_INPUT_SIZE];
+	unsigned char proposals[INPUT_QUEUE_FRAMES];
+	int last_frame;
+
+	// What synchronize_input handed out for a frame, and whether that was a
+	// prediction to check once the input arrives.
+	unsigned char used[INPUT_QUEUE_FRAMES * ROLLBACK_MAX_INPUT_SIZE];
+	bool predicted[INPUT_QUEUE_FRAMES];
+	// What each predictor guessed.
+	unsigned char guesses[ROLLBACK_MAX_PREDICTORS]
+		[INPUT_QUEUE_FRAMES * ROLLBACK_MAX_INPUT_SIZE];
+
+	bool disconnected;
+	int disconnect_frame;
+
+	// The rest is for remote players.
+	bool synchronized;
+	bool interrupted;
+	// The last frame of the local player the peer has.
+	int acked;
+	unsigned int last_received_ms;
+	unsigned int last_sent_ms;
+	bool has_echo;
+	unsigned int echo_ms;
+	int rtt_ms;
+	// Smoothed round trip and its mean deviation, as TCP keeps them.
+	bool has_rtt;
+	float srtt_ms;
+	float rttvar_ms;
+	long long bytes_sent;
+	unsigned int first_sent_ms;
+
+	int local_advantage;
+	int remote_advantage;
+	int local_advantages[TIMESYNC_WINDOW];
+	int remote_advantages[TIMESYNC_WINDOW];
+} Player;
+
+typedef struct SavedState
+{
+	int frame;
+	unsigned char *buffer;
+	int len;
+} SavedState;
+
+struct RollbackSession
+{
+	GGPOSessionCallbacks callbacks;
+	RollbackTransport transport;
+	int num_players;
+	int input_size;
+	int local_player;
+
+	// The frame the next synchronize_input is for.
+	int frame;
+	bool running;
+	bool in_rollback;
+	// The earliest frame simulated on a wrong prediction, or -1.
+	int first_incorrect;
+	int next_timesync_frame;
+
+	int disconnect_timeout;
+	int disconnect_notify_start;
+
+	bool adaptive_delay;
+	int min_frame_delay;
+	int max_frame_delay;
+	int proposed_delay;
+	// The last delay agreed on, or -1, and the epoch to agree on next.
+	int agreed_delay;
+	int next_delay_epoch;
+
+	Player players[ROLLBACK_MAX_PLAYERS];
+	SavedState states[SAVED_STATES];
+
+	RollbackPredictor predictors[ROLLBACK_MAX_PREDICTORS];
+	int num_predictors;
+	int predictor;
+
+	RollbackStats stats;
+	RollbackFrameTiming current;
+};
+
+static void put32(unsigned char *p, unsigned int x)
+{
+	p[0] = (unsigned char)x;
+	p[1] = (unsigned char)(x >> 8);
+	p[2] = (unsigned char)(x >> 16);
+	p[3] = (unsigned char)(x >> 24);
+}
+
+static unsigned int get32(unsigned char const *p)
+{
+	return (unsigned int)p[0] |
+		(unsigned int)p[1] << 8 |
+		(unsigned int)p[2] << 16 |
+		(unsigned int)p[3] << 24;
+}
+
+static unsigned char *input_at(
+	RollbackSession const *session, unsigned char *queue, int frame)
+{
+	return queue + (frame & (INPUT_QUEUE_FRAMES - 1)) * session->input_size;
+}
+
+static void repeat_observe(void *context, int player, void const *input)
+{
+	(void)context, (void)player, (void)input;
+}
+
+static void repeat_predict(
+	void *context,
+	int player,
+	void const *last_input,
+	int frames_ahead,
+	void *input)
+{
+	RollbackSession const *session = (RollbackSession const*)context;
+
+	(void)player, (void)frames_ahead;
+
+	memcpy(input, last_input, session->input_size);
+}
+
+static Player *player_of(RollbackSession *session, GGPOPlayerHandle handle)
+{
+	if (handle < 1 || handle > session->num_players)
+	{
+		return NULL;
+	}
+
+	Player *player = session->players + handle - 1;
+
+	return player->added ? player : NULL;
+}
+
+static unsigned int now_ms(RollbackSession *session)
+{
+	return session->transport.now_ms(session->transport.context);
+}
+
+static void emit(RollbackSession *session, GGPOEvent *event)
+{
+	if (session->callbacks.on_event)
+	{
+		session->callbacks.on_event(event);
+	}
+}
+
+static void emit_for_player(
+	RollbackSession *session, GGPOEventCode code, int index)
+{
+	GGPOEvent event;
+	memset(&event, 0, sizeof(event));
+
+	event.code = code;
+	// Every event that names a player keeps it in the same place.
+	event.u.connected.player = index + 1;
+
+	emit(session, &event);
+}
+
+static void save_state(RollbackSession *session)
+{
+	SavedState *state = session->states + session->frame % SAVED_STATES;
+	long long start = timer_ticks();
+
+	if (state->buffer)
+	{
+		session->callbacks.free_buffer(state->buffer);
+		state->buffer = NULL;
+	}
+
+	int checksum;
+
+	state->frame = session->frame;
+	session->callbacks.save_game_state(
+		&state->buffer, &state->len, &checksum, session->frame);
+
+	long long ticks = timer_ticks() - start;
+	session->stats.save_ticks += ticks;
+	session->current.save_ticks += ticks;
+
+	if (session->in_rollback)
+	{
+		session->stats.resimulate_save_ticks += ticks;
+	}
+}
+
+static SavedState *find_state(RollbackSession *session, int frame)
+{
+	SavedState *state = session->states + frame % SAVED_STATES;
+
+	return state->buffer && state->frame == frame ? state : NULL;
+}
+
+static void mark_incorrect(RollbackSession *session, int frame)
+{
+	if (session->first_incorrect < 0 || frame < session->first_incorrect)
+	{
+		session->first_incorrect = frame;
+	}
+}
+
+// All inputs are known up to and including this frame.
+static int confirmed_frame(RollbackSession const *session)
+{
+	int confirmed = session->frame;
+
+	for (int i = 0; i < session->num_players; i++)
+	{
+		Player const *player = session->players + i;
+
+		if (player->type == GGPO_PLAYERTYPE_REMOTE &&
+			!player->disconnected &&
+			player->last_frame < confirmed)
+		{
+			confirmed = player->last_frame;
+		}
+	}
+
+	return confirmed;
+}
+
+static void disconnect(RollbackSession *session, int index)
+{
+	Player *player = session->players + index;
+
+	player->disconnected = true;
+	player->disconnect_frame = player->last_frame + 1;
+
+	// Frames since were simulated on predictions rather than as disconnected.
+	if (player->disconnect_frame < session->frame)
+	{
+		mark_incorrect(session, player->disconnect_frame);
+	}
+}
+
+static void send_inputs(RollbackSession *session, int index)
+{
+	Player *remote = session->players + index;
+	unsigned char message[MAX_MESSAGE_SIZE];
+	unsigned int now = now_ms(session);
+	int start = remote->acked + 1;
+	int count = 0;
+
+	if (session->local_player >= 0)
+	{
+		Player *local = session->players + session->local_player;
+
+		if (start < local->last_frame - (INPUT_QUEUE_FRAMES - 1))
+		{
+			start = local->last_frame - (INPUT_QUEUE_FRAMES - 1);
+		}
+
+		count = local->last_frame - start + 1;
+		count = count < 0 ? 0 : count;
+		count = count > MAX_MESSAGE_FRAMES ? MAX_MESSAGE_FRAMES : count;
+
+		unsigned char *proposals =
+			message + MESSAGE_HEADER_SIZE + count * session->input_size;
+
+		for (int i = 0; i < count; i++)
+		{
+			memcpy(message + MESSAGE_HEADER_SIZE + i * session->input_size,
+				input_at(session, local->inputs, start + i),
+				session->input_size);
+
+			proposals[i] =
+				local->proposals[(start + i) & (INPUT_QUEUE_FRAMES - 1)];
+		}
+	}
+
+	memset(message, 0, MESSAGE_HEADER_SIZE);
+	message[0] = MESSAGE_input;
+	message[1] = (unsigned char)(session->local_player < 0
+		? 0xff
+		: session->local_player);
+	message[2] = (unsigned char)session->input_size;
+	message[3] = (unsigned char)count;
+	message[4] = remote->has_echo ? MESSAGE_FLAG_echo : 0;
+	put32(message + 8, (unsigned int)session->frame);
+	put32(message + 12, (unsigned int)remote->local_advantage);
+	put32(message + 16, (unsigned int)remote->last_frame);
+	put32(message + 20, (unsigned int)start);
+	put32(message + 24, now);
+	put32(message + 28, remote->echo_ms);
+
+	int len = MESSAGE_HEADER_SIZE + count * (session->input_size + 1);
+
+	session->transport.send(
+		session->transport.context, remote->peer, message, len);
+
+	if (!remote->bytes_sent)
+	{
+		remote->first_sent_ms = now;
+	}
+
+	remote->last_sent_ms = now;
+	remote->bytes_sent += len;
+}
+
+static void send_to_all(RollbackSession *session, bool only_if_due)
+{
+	unsigned int now = now_ms(session);
+
+	for (int i = 0; i < session->num_players; i++)
+	{
+		Player *player = session->players + i;
+
+		if (player->type != GGPO_PLAYERTYPE_REMOTE ||
+			!player->added ||
+			player->disconnected)
+		{
+			continue;
+		}
+
+		if (!only_if_due || now - player->last_sent_ms >= SEND_INTERVAL_MS)
+		{
+			send_inputs(session, i);
+		}
+	}
+}
+
+static void receive_inputs(
+	RollbackSession *session,
+	Player *player,
+	int start,
+	int count,
+	unsigned char const *inputs)
+{
+	unsigned char const *proposals = inputs + count * session->input_size;
+
+	for (int i = 0; i < count; i++)
+	{
+		int frame = start + i;
+		unsigned char const *input = inputs + i * session->input_size;
+
+		if (frame <= player->last_frame)
+		{
+			continue;
+		}
+
+		// A gap, the rest will come again.
+		if (frame != player->last_frame + 1 ||
+			frame - session->frame >= INPUT_QUEUE_FRAMES / 2)
+		{
+			break;
+		}
+
+		memcpy(input_at(session, player->inputs, frame),
+			input,
+			session->input_size);
+
+		player->proposals[frame & (INPUT_QUEUE_FRAMES - 1)] = proposals[i];
+		player->last_frame = frame;
+
+		for (int k = 0; k < session->num_predictors; k++)
+		{
+			session->predictors[k].observe(session->predictors[k].context,
+				(int)(player - session->players),
+				input);
+		}
+
+		if (frame >= session->frame ||
+			!player->predicted[frame & (INPUT_QUEUE_FRAMES - 1)])
+		{
+			continue;
+		}
+
+		for (int k = 0; k < session->num_predictors; k++)
+		{
+			RollbackPredictorStats *stats = session->stats.predictors + k;
+
+			stats->predictions++;
+
+			if (memcmp(input_at(session, player->guesses[k], frame),
+				input,
+				session->input_size))
+			{
+				stats->mispredictions++;
+			}
+		}
+
+		RollbackPlayerStats *stats =
+			session->stats.players + (player - session->players);
+
+		stats->predictions++;
+
+		if (memcmp(input_at(session, player->used, frame),
+			input,
+			session->input_size))
+		{
+			stats->mispredictions++;
+			mark_incorrect(session, frame);
+		}
+	}
+}
+
+static void measure_rtt(Player *player)
+{
+	float rtt = (float)player->rtt_ms;
+
+	if (!player->has_rtt)
+	{
+		player->has_rtt = true;
+		player->srtt_ms = rtt;
+		player->rttvar_ms = rtt / 2;
+		return;
+	}
+
+	float deviation = rtt > player->srtt_ms
+		? rtt - player->srtt_ms
+		: player->srtt_ms - rtt;
+
+	player->rttvar_ms = player->rttvar_ms * 0.75f + deviation * 0.25f;
+	player->srtt_ms = player->srtt_ms * 0.875f + rtt * 0.125f;
+}
+
+static void handle_message(
+	RollbackSession *session,
+	int peer,
+	unsigned char const *message,
+	int len)
+{
+	if (len < MESSAGE_HEADER_SIZE || message[0] != MESSAGE_input)
+	{
+		return;
+	}
+
+	int index = message[1];
+	int input_size = message[2];
+	int count = message[3];
+
+	if (index >= session->num_players ||
+		input_size != session->input_size ||
+		len < MESSAGE_HEADER_SIZE + count * (input_size + 1))
+	{
+		return;
+	}
+
+	Player *player = session->players + index;
+
+	if (!player->added ||
+		player->type != GGPO_PLAYERTYPE_REMOTE ||
+		player->peer != peer ||
+		player->disconnected)
+	{
+		return;
+	}
+
+	unsigned int now = now_ms(session);
+	player->last_received_ms = now;
+
+	if (!player->synchronized)
+	{
+		player->synchronized = true;
+		emit_for_player(session, GGPO_EVENTCODE_CONNECTED_TO_PEER, index);
+		emit_for_player(session, GGPO_EVENTCODE_SYNCHRONIZED_WITH_PEER, index);
+	}
+
+	if (player->interrupted)
+	{
+		player->interrupted = false;
+		emit_for_player(session, GGPO_EVENTCODE_CONNECTION_RESUMED, index);
+	}
+
+	int frame = (int)get32(message + 8);
+	int ack = (int)get32(message + 16);
+
+	if (ack > player->acked)
+	{
+		player->acked = ack;
+	}
+
+	if (message[4] & MESSAGE_FLAG_echo)
+	{
+		player->rtt_ms = (int)(now - get32(message + 28));
+		measure_rtt(player);
+	}
+
+	player->has_echo = true;
+	player->echo_ms = get32(message + 24);
+
+	// Where the peer is by now, given that the message took half a round trip.
+	player->local_advantage =
+		frame + player->rtt_ms * 60 / 2000 - session->frame;
+	player->remote_advantage = (int)get32(message + 12);
+
+	receive_inputs(session,
+		player,
+		(int)get32(message + 20),
+		count,
+		message + MESSAGE_HEADER_SIZE);
+}
+
+static void poll(RollbackSession *session)
+{
+	unsigned char message[MAX_MESSAGE_SIZE];
+	int peer, len;
+
+	while ((len = session->transport.receive(
+		session->transport.context, &peer, message, sizeof(message))) > 0)
+	{
+		handle_message(session, peer, message, len);
+	}
+}
+
+static void check_running(RollbackSession *session)
+{
+	if (session->running)
+	{
+		return;
+	}
+
+	for (int i = 0; i < session->num_players; i++)
+	{
+		Player const *player = session->players + i;
+
+		if (!player->added ||
+			(player->type == GGPO_PLAYERTYPE_REMOTE && !player->synchronized))
+		{
+			return;
+		}
+	}
+
+	session->running = true;
+
+	GGPOEvent event;
+	memset(&event, 0, sizeof(event));
+	event.code = GGPO_EVENTCODE_RUNNING;
+	emit(session, &event);
+}
+
+static void check_timeouts(RollbackSession *session)
+{
+	unsigned int now = now_ms(session);
+
+	for (int i = 0; i < session->num_players; i++)
+	{
+		Player *player = session->players + i;
+
+		if (player->type != GGPO_PLAYERTYPE_REMOTE || player->disconnected)
+		{
+			continue;
+		}
+
+		unsigned int silent = now - player->last_received_ms;
+
+		if (session->disconnect_timeout &&
+			silent > (unsigned int)session->disconnect_timeout)
+		{
+			disconnect(session, i);
+			emit_for_player(
+				session, GGPO_EVENTCODE_DISCONNECTED_FROM_PEER, i);
+		}
+		else if (session->disconnect_notify_start &&
+			!player->interrupted &&
+			silent > (unsigned int)session->disconnect_notify_start)
+		{
+			GGPOEvent event;
+			memset(&event, 0, sizeof(event));
+			event.code = GGPO_EVENTCODE_CONNECTION_INTERRUPTED;
+			event.u.connection_interrupted.player = i + 1;
+			event.u.connection_interrupted.disconnect_timeout =
+				session->disconnect_timeout - session->disconnect_notify_start;
+
+			player->interrupted = true;
+			emit(session, &event);
+		}
+	}
+}
+
+static int recommend_frame_wait(Player const *player)
+{
+	float local = 0, remote = 0;
+
+	for (int i = 0; i < TIMESYNC_WINDOW; i++)
+	{
+		local += player->local_advantages[i];
+		remote += player->remote_advantages[i];
+	}
+
+	local /= TIMESYNC_WINDOW;
+	remote /= TIMESYNC_WINDOW;
+
+	// Behind or even, leave catching up to the peer.
+	if (local >= remote)
+	{
+		return 0;
+	}
+
+	int frames = (int)((remote - local) / 2 + 0.5f);
+
+	if (frames < MIN_FRAME_ADVANTAGE)
+	{
+		return 0;
+	}
+
+	return frames > MAX_FRAME_ADVANTAGE ? MAX_FRAME_ADVANTAGE : frames;
+}
+
+static void check_timesync(RollbackSession *session)
+{
+	if (session->frame <= session->next_timesync_frame)
+	{
+		return;
+	}
+
+	int wait = 0;
+
+	for (int i = 0; i < session->num_players; i++)
+	{
+		Player const *player = session->players + i;
+
+		if (player->type == GGPO_PLAYERTYPE_REMOTE && !player->disconnected)
+		{
+			int frames = recommend_frame_wait(player);
+			wait = frames > wait ? frames : wait;
+		}
+	}
+
+	if (wait > 0)
+	{
+		GGPOEvent event;
+		memset(&event, 0, sizeof(event));
+		event.code = GGPO_EVENTCODE_TIMESYNC;
+		event.u.timesync.frames_ahead = wait;
+		emit(session, &event);
+
+		session->next_timesync_frame = session->frame + TIMESYNC_INTERVAL;
+	}
+}
+
+// The delay that leaves the inputs of the furthest peer, one way and allowing
+// for jitter, as many frames late as replays can afford, given what replaying
+// a frame has cost so far. Until there is a round trip to go on, the current
+// delay.
+static int propose_delay(
+	RollbackSession const *session, int current, int margin_ms)
+{
+	float latency_ms = 0;
+	bool measured = false;
+
+	for (int i = 0; i < session->num_players; i++)
+	{
+		Player const *player = session->players + i;
+
+		if (player->type == GGPO_PLAYERTYPE_REMOTE &&
+			!player->disconnected &&
+			player->has_rtt)
+		{
+			float one_way = player->srtt_ms / 2 + player->rttvar_ms * 2;
+			latency_ms = one_way > latency_ms ? one_way : latency_ms;
+			measured = true;
+		}
+	}
+
+	if (!measured)
+	{
+		return current;
+	}
+
+	int late = (int)((latency_ms + margin_ms) * 60 / 1000 + 0.999f);
+	int affordable = DELAY_ROLLBACK_FRAMES;
+
+	if (session->stats.frames_resimulated)
+	{
+		double frame_ns = timer_ticks_to_ns(session->stats.resimulate_ticks) /
+			session->stats.frames_resimulated;
+
+		if (frame_ns * affordable > DELAY_ROLLBACK_BUDGET_NS)
+		{
+			affordable = (int)(DELAY_ROLLBACK_BUDGET_NS / frame_ns);
+		}
+	}
+
+	int delay = late - affordable;
+
+	delay = delay < session->min_frame_delay ? session->min_frame_delay : delay;
+	delay = delay > session->max_frame_delay ? session->max_frame_delay : delay;
+
+	return delay;
+}
+
+// Agrees on the delay of every epoch due by now, which every peer does the
+// same way from the same inputs: the largest delay proposed for the epoch's
+// frame, at most a frame away from the last one agreed on. Then proposes the
+// delay to go with the next input.
+static void update_delay(RollbackSession *session, Player *local)
+{
+	while (session->next_delay_epoch * DELAY_EPOCH_FRAMES + DELAY_LEAD_FRAMES <=
+		session->frame)
+	{
+		int frame = session->next_delay_epoch * DELAY_EPOCH_FRAMES;
+		int last = session->agreed_delay;
+		int delay = 0;
+
+		for (int i = 0; i < session->num_players; i++)
+		{
+			Player const *player = session->players + i;
+			int proposal =
+				player->proposals[frame & (INPUT_QUEUE_FRAMES - 1)];
+
+			if (player->added &&
+				player->last_frame >= frame &&
+				proposal > delay)
+			{
+				delay = proposal;
+			}
+		}
+
+		if (last >= 0)
+		{
+			delay = delay > last + 1 ? last + 1 : delay;
+			delay = delay < last - 1 ? last - 1 : delay;
+
+			if (delay != last)
+			{
+				session->stats.delay_changes++;
+				session->stats.last_delay_change = frame + DELAY_LEAD_FRAMES;
+			}
+		}
+
+		session->agreed_delay = delay;
+		session->next_delay_epoch++;
+	}
+
+	if (session->adaptive_delay && session->agreed_delay >= 0)
+	{
+		local->frame_delay = session->agreed_delay;
+	}
+
+	if (!session->adaptive_delay)
+	{
+		session->proposed_delay = local->frame_delay;
+		return;
+	}
+
+	int delay = propose_delay(session, local->frame_delay, 0);
+
+	// Don't come down while close to where coming down would be wrong.
+	if (delay < local->frame_delay)
+	{
+		delay = propose_delay(
+			session, local->frame_delay, DELAY_HYSTERESIS_MS);
+	}
+
+	session->proposed_delay = delay;
+}
+
+// Loads the last state simulated on correct inputs and replays the frames
+// since, which the game does by calling rollback_synchronize_input and
+// rollback_advance_frame from advance_frame like any other frame. Fails if
+// that state is no longer saved, or if the game stops advancing before it is
+// back where it was, either of which leaves the game wrong from then on.
+static GGPOErrorCode adjust_simulation(RollbackSession *session)
+{
+	int target = session->frame;
+	int first = session->first_incorrect;
+
+	if (first >= target)
+	{
+		session->first_incorrect = -1;
+		return GGPO_OK;
+	}
+
+	SavedState *state = find_state(session, first);
+
+	// Left incorrect, so that every later idle fails too.
+	if (!state)
+	{
+		return GGPO_ERRORCODE_GENERAL_FAILURE;
+	}
+
+	session->first_incorrect = -1;
+
+	long long rollback_start = timer_ticks();
+	long long start = rollback_start;
+	session->callbacks.load_game_state(state->buffer, state->len);
+	long long ticks = timer_ticks() - start;
+
+	session->stats.load_ticks += ticks;
+	session->current.load_ticks += ticks;
+
+	session->frame = first;
+	session->in_rollback = true;
+	start = timer_ticks();
+
+	while (session->frame < target)
+	{
+		int frame = session->frame;
+
+		session->callbacks.advance_frame(0);
+
+		// The game didn't advance, don't spin.
+		if (session->frame == frame)
+		{
+			break;
+		}
+	}
+
+	long long end = timer_ticks();
+	session->stats.resimulate_ticks += end - start;
+	session->current.resimulate_ticks += end - start;
+	session->in_rollback = false;
+
+	if (session->frame < target)
+	{
+		session->stats.failed_rollbacks++;
+		return GGPO_ERRORCODE_GENERAL_FAILURE;
+	}
+
+	int depth = target - first;
+
+	session->stats.rollbacks++;
+	session->stats.frames_resimulated += depth;
+	session->current.resimulated += depth;
+
+	if (depth > session->stats.max_rollback_depth)
+	{
+		session->stats.max_rollback_depth = depth;
+	}
+
+	session->stats.depth_histogram[depth < ROLLBACK_DEPTH_BUCKETS
+		? depth
+		: ROLLBACK_DEPTH_BUCKETS - 1]++;
+
+	long long us = (long long)(timer_ticks_to_ns(end - rollback_start) / 1000);
+	int bucket = 0;
+
+	while (bucket < ROLLBACK_COST_BUCKETS - 1 && us >= 1LL << bucket)
+	{
+		bucket++;
+	}
+
+	session->stats.cost_histogram[bucket]++;
+
+	return GGPO_OK;
+}
+
+GGPOErrorCode rollback_start_session(
+	RollbackSession **session,
+	GGPOSessionCallbacks const *callbacks,
+	RollbackTransport const *transport,
+	int num_players,
+	int input_size)
+{
+	if (num_players < 1 || num_players > ROLLBACK_MAX_PLAYERS)
+	{
+		return GGPO_ERRORCODE_PLAYER_OUT_OF_RANGE;
+	}
+
+	if (input_size < 1 || input_size > ROLLBACK_MAX_INPUT_SIZE)
+	{
+		return GGPO_ERRORCODE_INVALID_REQUEST;
+	}
+
+	RollbackSession *s = (RollbackSession*)calloc(1, sizeof(RollbackSession));
+
+	if (!s)
+	{
+		return GGPO_ERRORCODE_GENERAL_FAILURE;
+	}
+
+	s->callbacks = *callbacks;
+	s->transport = *transport;
+	s->num_players = num_players;
+	s->input_size = input_size;
+	s->local_player = -1;
+	s->first_incorrect = -1;
+	s->disconnect_timeout = DEFAULT_DISCONNECT_TIMEOUT;
+	s->disconnect_notify_start = DEFAULT_NOTIFY_START;
+	s->agreed_delay = -1;
+	s->stats.num_players = num_players;
+
+	s->predictors[0].name = "repeat";
+	s->predictors[0].context = s;
+	s->predictors[0].observe = repeat_observe;
+	s->predictors[0].predict = repeat_predict;
+	s->num_predictors = 1;
+	s->stats.predictors[0].name = "repeat";
+	s->stats.num_predictors = 1;
+
+	for (int i = 0; i < ROLLBACK_MAX_PLAYERS; i++)
+	{
+		s->players[i].last_frame = -1;
+		s->players[i].acked = -1;
+	}
+
+	for (int i = 0; i < SAVED_STATES; i++)
+	{
+		s->states[i].frame = -1;
+	}
+
+	*session = s;
+
+	return GGPO_OK;
+}
+
+GGPOErrorCode rollback_add_player(
+	RollbackSession *session,
+	GGPOPlayer const *player,
+	int peer,
+	GGPOPlayerHandle *handle)
+{
+	if (player->type == GGPO_PLAYERTYPE_SPECTATOR)
+	{
+		return GGPO_ERRORCODE_UNSUPPORTED;
+	}
+
+	int index = player->player_num - 1;
+
+	if (index < 0 || index >= session->num_players)
+	{
+		return GGPO_ERRORCODE_PLAYER_OUT_OF_RANGE;
+	}
+
+	Player *added = session->players + index;
+
+	if (added->added ||
+		(player->type == GGPO_PLAYERTYPE_LOCAL && session->local_player >= 0))
+	{
+		return GGPO_ERRORCODE_INVALID_REQUEST;
+	}
+
+	added->added = true;
+	added->type = player->type;
+	added->peer = peer;
+	added->last_received_ms = now_ms(session);
+
+	if (player->type == GGPO_PLAYERTYPE_LOCAL)
+	{
+		session->local_player = index;
+	}
+
+	*handle = player->player_num;
+
+	return GGPO_OK;
+}
+
+GGPOErrorCode rollback_close_session(RollbackSession *session)
+{
+	for (int i = 0; i < SAVED_STATES; i++)
+	{
+		if (session->states[i].buffer)
+		{
+			session->callbacks.free_buffer(session->states[i].buffer);
+		}
+	}
+
+	free(session);
+
+	return GGPO_OK;
+}
+
+GGPOErrorCode rollback_set_frame_delay(
+	RollbackSession *session, GGPOPlayerHandle handle, int frame_delay)
+{
+	Player *player = player_of(session, handle);
+
+	if (!player || player->type != GGPO_PLAYERTYPE_LOCAL)
+	{
+		return GGPO_ERRORCODE_INVALID_PLAYER_HANDLE;
+	}
+
+	if (frame_delay < 0 || frame_delay > MAX_FRAME_DELAY)
+	{
+		return GGPO_ERRORCODE_INVALID_REQUEST;
+	}
+
+	player->frame_delay = frame_delay;
+	session->adaptive_delay = false;
+
+	return GGPO_OK;
+}
+
+GGPOErrorCode rollback_set_adaptive_frame_delay(
+	RollbackSession *session,
+	GGPOPlayerHandle handle,
+	int min_frame_delay,
+	int max_frame_delay)
+{
+	Player *player = player_of(session, handle);
+
+	if (!player || player->type != GGPO_PLAYERTYPE_LOCAL)
+	{
+		return GGPO_ERRORCODE_INVALID_PLAYER_HANDLE;
+	}
+
+	if (min_frame_delay < 0 ||
+		min_frame_delay > max_frame_delay ||
+		max_frame_delay > MAX_FRAME_DELAY)
+	{
+		return GGPO_ERRORCODE_INVALID_REQUEST;
+	}
+
+	session->adaptive_delay = true;
+	session->min_frame_delay = min_frame_delay;
+	session->max_frame_delay = max_frame_delay;
+
+	if (player->frame_delay < min_frame_delay)
+	{
+		player->frame_delay = min_frame_delay;
+	}
+
+	if (player->frame_delay > max_frame_delay)
+	{
+		player->frame_delay = max_frame_delay;
+	}
+
+	return GGPO_OK;
+}
+
+GGPOErrorCode rollback_idle(RollbackSession *session)
+{
+	if (session->in_rollback)
+	{
+		return GGPO_ERRORCODE_IN_ROLLBACK;
+	}
+
+	long long start = timer_ticks();
+
+	poll(session);
+	check_running(session);
+	send_to_all(session, true);
+
+	if (session->running)
+	{
+		check_timeouts(session);
+		check_timesync(session);
+	}
+
+	long long ticks = timer_ticks() - start;
+	session->stats.poll_ticks += ticks;
+	session->current.poll_ticks += ticks;
+
+	if (session->first_incorrect >= 0)
+	{
+		return adjust_simulation(session);
+	}
+
+	return GGPO_OK;
+}
+
+GGPOErrorCode rollback_add_local_input(
+	RollbackSession *session,
+	GGPOPlayerHandle handle,
+	void const *values,
+	int size)
+{
+	Player *player = player_of(session, handle);
+
+	if (!player || player->type != GGPO_PLAYERTYPE_LOCAL)
+	{
+		return GGPO_ERRORCODE_INVALID_PLAYER_HANDLE;
+	}
+
+	if (session->in_rollback)
+	{
+		return GGPO_ERRORCODE_IN_ROLLBACK;
+	}
+
+	if (!session->running)
+	{
+		return GGPO_ERRORCODE_NOT_SYNCHRONIZED;
+	}
+
+	if (size != session->input_size)
+	{
+		return GGPO_ERRORCODE_INVALID_REQUEST;
+	}
+
+	if (session->frame - confirmed_frame(session) > ROLLBACK_MAX_PREDICTION)
+	{
+		return GGPO_ERRORCODE_PREDICTION_THRESHOLD;
+	}
+
+	if (session->frame == 0 && !find_state(session, 0))
+	{
+		save_state(session);
+	}
+
+	update_delay(session, player);
+
+	int target = session->frame + player->frame_delay;
+
+	// The delay went down and the frame already has an input. This one is
+	// dropped, which is what brings the inputs a frame closer.
+	if (target <= player->last_frame)
+	{
+		session->stats.inputs_dropped++;
+		session->stats.input_lead = player->last_frame - session->frame;
+		return GGPO_OK;
+	}
+
+	// The delay went up, or this is the first input. Repeat the last input,
+	// or nothing, over the frames skipped.
+	for (int frame = player->last_frame + 1; frame < target; frame++)
+	{
+		unsigned char *input = input_at(session, player->inputs, frame);
+
+		if (player->last_frame < 0)
+		{
+			memset(input, 0, session->input_size);
+		}
+		else
+		{
+			memcpy(input,
+				input_at(session, player->inputs, player->last_frame),
+				session->input_size);
+		}
+
+		player->proposals[frame & (INPUT_QUEUE_FRAMES - 1)] =
+			(unsigned char)session->proposed_delay;
+		player->last_frame = frame;
+	}
+
+	memcpy(input_at(session, player->inputs, target),
+		values,
+		session->input_size);
+
+	player->proposals[target & (INPUT_QUEUE_FRAMES - 1)] =
+		(unsigned char)session->proposed_delay;
+	player->last_frame = target;
+	session->stats.input_lead = target - session->frame;
+
+	send_to_all(session, false);
+
+	return GGPO_OK;
+}
+
+GGPOErrorCode rollback_synchronize_input(
+	RollbackSession *session,
+	void *values,
+	int size,
+	int *disconnect_flags)
+{
+	if (!session->running)
+	{
+		return GGPO_ERRORCODE_NOT_SYNCHRONIZED;
+	}
+
+	if (size < session->num_players * session->input_size)
+	{
+		return GGPO_ERRORCODE_INVALID_REQUEST;
+	}
+
+	int frame = session->frame;
+
+	memset(values, 0, size);
+
+	if (disconnect_flags)
+	{
+		*disconnect_flags = 0;
+	}
+
+	for (int i = 0; i < session->num_players; i++)
+	{
+		Player *player = session->players + i;
+		unsigned char *out =
+			(unsigned char*)values + i * session->input_size;
+		bool *predicted =
+			player->predicted + (frame & (INPUT_QUEUE_FRAMES - 1));
+
+		if (player->disconnected && frame >= player->disconnect_frame)
+		{
+			if (disconnect_flags)
+			{
+				*disconnect_flags |= 1u << i;
+			}
+
+			*predicted = false;
+		}
+		else if (player->last_frame >= frame)
+		{
+			memcpy(out,
+				input_at(session, player->inputs, frame),
+				session->input_size);
+
+			*predicted = false;
+		}
+		else
+		{
+			// The predictor guesses from the last confirmed input. Before any
+			// has arrived, the player is taken to be doing nothing.
+			if (player->last_frame >= 0)
+			{
+				for (int k = 0; k < session->num_predictors; k++)
+				{
+					session->predictors[k].predict(
+						session->predictors[k].context,
+						i,
+						input_at(session, player->inputs, player->last_frame),
+						frame - player->last_frame,
+						input_at(session, player->guesses[k], frame));
+				}
+
+				memcpy(out,
+					input_at(session, player->guesses[session->predictor], frame),
+					session->input_size);
+			}
+
+			*predicted = true;
+		}
+
+		memcpy(input_at(session, player->used, frame),
+			out,
+			session->input_size);
+	}
+
+	return GGPO_OK;
+}
+
+GGPOErrorCode rollback_add_predictor(
+	RollbackSession *session,
+	RollbackPredictor const *predictor,
+	int *index)
+{
+	if (session->num_predictors == ROLLBACK_MAX_PREDICTORS)
+	{
+		return GGPO_ERRORCODE_INVALID_REQUEST;
+	}
+
+	RollbackPredictorStats *stats =
+		session->stats.predictors + session->num_predictors;
+
+	stats->name = predictor->name;
+	session->predictors[session->num_predictors] = *predictor;
+	*index = session->num_predictors++;
+	session->stats.num_predictors = session->num_predictors;
+
+	return GGPO_OK;
+}
+
+GGPOErrorCode rollback_use_predictor(RollbackSession *session, int index)
+{
+	if (index < 0 || index >= session->num_predictors)
+	{
+		return GGPO_ERRORCODE_INVALID_REQUEST;
+	}
+
+	session->predictor = index;
+
+	return GGPO_OK;
+}
+
+GGPOErrorCode rollback_disconnect_player(
+	RollbackSession *session, GGPOPlayerHandle handle)
+{
+	Player *player = player_of(session, handle);
+
+	if (!player)
+	{
+		return GGPO_ERRORCODE_INVALID_PLAYER_HANDLE;
+	}
+
+	if (player->type != GGPO_PLAYERTYPE_REMOTE)
+	{
+		return GGPO_ERRORCODE_INVALID_REQUEST;
+	}
+
+	if (player->disconnected)
+	{
+		return GGPO_ERRORCODE_PLAYER_DISCONNECTED;
+	}
+
+	disconnect(session, handle - 1);
+
+	return GGPO_OK;
+}
+
+GGPOErrorCode rollback_advance_frame(RollbackSession *session)
+{
+	session->frame++;
+
+	if (!session->in_rollback)
+	{
+		int slot = session->frame % TIMESYNC_WINDOW;
+
+		for (int i = 0; i < session->num_players; i++)
+		{
+			Player *player = session->players + i;
+			player->local_advantages[slot] = player->local_advantage;
+			player->remote_advantages[slot] = player->remote_advantage;
+		}
+
+		session->stats.frames++;
+		session->current.frame = session->frame - 1;
+		session->stats.recent[
+			session->current.frame & (ROLLBACK_TIMING_FRAMES - 1)] =
+				session->current;
+
+		memset(&session->current, 0, sizeof(session->current));
+	}
+
+	save_state(session);
+
+	return GGPO_OK;
+}
+
+GGPOErrorCode rollback_get_network_stats(
+	RollbackSession *session,
+	GGPOPlayerHandle handle,
+	GGPONetworkStats *stats)
+{
+	Player *player = player_of(session, handle);
+
+	if (!player || player->type != GGPO_PLAYERTYPE_REMOTE)
+	{
+		return GGPO_ERRORCODE_INVALID_PLAYER_HANDLE;
+	}
+
+	memset(stats, 0, sizeof(*stats));
+
+	unsigned int elapsed = now_ms(session) - player->first_sent_ms;
+
+	if (session->local_player >= 0)
+	{
+		stats->network.send_queue_len =
+			session->players[session->local_player].last_frame -
+			player->acked;
+	}
+
+	stats->network.recv_queue_len =
+		player->last_frame >= session->frame
+			? player->last_frame - session->frame + 1
+			: 0;
+
+	stats->network.ping = player->rtt_ms;
+	stats->network.kbps_sent =
+		elapsed ? (int)(player->bytes_sent * 8 / elapsed) : 0;
+
+	stats->timesync.local_frames_behind = player->local_advantage;
+	stats->timesync.remote_frames_behind = player->remote_advantage;
+
+	return GGPO_OK;
+}
+
+GGPOErrorCode rollback_set_disconnect_timeout(
+	RollbackSession *session, int timeout)
+{
+	session->disconnect_timeout = timeout;
+
+	return GGPO_OK;
+}
+
+GGPOErrorCode rollback_set_disconnect_notify_start(
+	RollbackSession *session, int timeout)
+{
+	session->disconnect_notify_start = timeout;
+
+	return GGPO_OK;
+}
+
+int rollback_frame_number(RollbackSession const *session)
+{
+	return session->frame;
+}
+
+int rollback_confirmed_frame(RollbackSession const *session)
+{
+	return confirmed_frame(session);
+}
+
+void rollback_get_stats(RollbackSession const *session, RollbackStats *stats)
+{
+	*stats = session->stats;
+
+	if (session->local_player >= 0)
+	{
+		stats->frame_delay = session->players[session->local_player].frame_delay;
+	}
+
+	stats->proposed_delay = session->proposed_delay;
+}
+
+void rollback_write_stats(RollbackStats const *stats, FILE *file)
+{
+	fprintf(file, "metric,key,value\n");
+	fprintf(file, "frames,,%lld\n", stats->frames);
+	fprintf(file, "rollbacks,,%lld\n", stats->rollbacks);
+	fprintf(file, "failed_rollbacks,,%lld\n", stats->failed_rollbacks);
+	fprintf(file, "frames_resimulated,,%lld\n", stats->frames_resimulated);
+	fprintf(file, "max_rollback_depth,,%d\n", stats->max_rollback_depth);
+	fprintf(file, "save_ns,,%.0f\n", timer_ticks_to_ns(stats->save_ticks));
+	fprintf(file, "load_ns,,%.0f\n", timer_ticks_to_ns(stats->load_ticks));
+	fprintf(file, "resimulate_ns,,%.0f\n",
+		timer_ticks_to_ns(stats->resimulate_ticks));
+	fprintf(file, "resimulate_save_ns,,%.0f\n",
+		timer_ticks_to_ns(stats->resimulate_save_ticks));
+	fprintf(file, "resimulate_step_ns,,%.0f\n",
+		timer_ticks_to_ns(
+			stats->resimulate_ticks - stats->resimulate_save_ticks));
+	fprintf(file, "poll_ns,,%.0f\n", timer_ticks_to_ns(stats->poll_ticks));
+	fprintf(file, "frame_delay,,%d\n", stats->frame_delay);
+	fprintf(file, "proposed_delay,,%d\n", stats->proposed_delay);
+	fprintf(file, "delay_changes,,%lld\n", stats->delay_changes);
+	fprintf(file, "last_delay_change,,%d\n", stats->last_delay_change);
+	fprintf(file, "input_lead,,%d\n", stats->input_lead);
+	fprintf(file, "inputs_dropped,,%lld\n", stats->inputs_dropped);
+
+	for (int i = 1; i < ROLLBACK_DEPTH_BUCKETS; i++)
+	{
+		fprintf(file, "depth,%d%s,%lld\n",
+			i,
+			i == ROLLBACK_DEPTH_BUCKETS - 1 ? "+" : "",
+			stats->depth_histogram[i]);
+	}
+
+	for (int i = 0; i < ROLLBACK_COST_BUCKETS; i++)
+	{
+		fprintf(file, "cost_us,%s%lld,%lld\n",
+			i < ROLLBACK_COST_BUCKETS - 1 ? "<" : ">=",
+			1LL << (i < ROLLBACK_COST_BUCKETS - 1 ? i : i - 1),
+			stats->cost_histogram[i]);
+	}
+
+	for (int i = 0; i < stats->num_predictors; i++)
+	{
+		fprintf(file, "predictor_predictions,%s,%lld\n",
+			stats->predictors[i].name, stats->predictors[i].predictions);
+		fprintf(file, "predictor_mispredictions,%s,%lld\n",
+			stats->predictors[i].name, stats->predictors[i].mispredictions);
+	}
+
+	for (int i = 0; i < stats->num_players; i++)
+	{
+		fprintf(file, "predictions,%d,%lld\n",
+			i + 1, stats->players[i].predictions);
+		fprintf(file, "mispredictions,%d,%lld\n",
+			i + 1, stats->players[i].mispredictions);
+	}
+
+	long long first = stats->frames > ROLLBACK_TIMING_FRAMES
+		? stats->frames - ROLLBACK_TIMING_FRAMES
+		: 0;
+
+	for (long long frame = first; frame < stats->frames; frame++)
+	{
+		RollbackFrameTiming const *timing =
+			stats->recent + (frame & (ROLLBACK_TIMING_FRAMES - 1));
+
+		fprintf(file, "frame_resimulated,%d,%d\n",
+			timing->frame, timing->resimulated);
+		fprintf(file, "frame_save_ns,%d,%.0f\n",
+			timing->frame, timer_ticks_to_ns(timing->save_ticks));
+		fprintf(file, "frame_load_ns,%d,%.0f\n",
+			timing->frame, timer_ticks_to_ns(timing->load_ticks));
+		fprintf(file, "frame_resimulate_ns,%d,%.0f\n",
+			timing->frame, timer_ticks_to_ns(timing->resimulate_ticks));
+		fprintf(file, "frame_poll_ns,%d,%.0f\n",
+			timing->frame, timer_ticks_to_ns(timing->poll_ticks));
+	}
+}
+
+int rollback_export_stats(RollbackStats const *stats, char const *filename)
+{
+	FILE *file = fopen(filename, "w");
+
+	if (!file)
+	{
+		return false;
+	}
+
+	rollback_write_stats(stats, file);
+
+	return fclose(file) == 0;
+}
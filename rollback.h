@@ -0,0 +1,238 @@
+#ifndef _ROLLBACK_H_
+#define _ROLLBACK_H_
+
+// ggponet.h is written against MSVC.
+#if !defined(_MSC_VER) && !defined(__cdecl)
+#define __cdecl
+#endif
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <ggponet.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// An in-tree rollback session, standing in for GGPO behind the same
+// GGPOSessionCallbacks, error codes and events. It keeps an input queue per
+// player, predicts the inputs of remote players that haven't arrived yet,
+// and, when one turns out wrong, loads the last correct state and replays the
+// frames since through advance_frame. Unlike GGPO it has no network code of
+// its own: datagrams go through a RollbackTransport.
+
+#define ROLLBACK_MAX_PLAYERS         32
+#define ROLLBACK_MAX_PREDICTION      GGPO_MAX_PREDICTION_FRAMES
+#define ROLLBACK_MAX_INPUT_SIZE      32
+
+// Frames of timing kept by rollback_get_stats. Must be a power of two.
+#define ROLLBACK_TIMING_FRAMES       128
+
+// Including the one that repeats the last input.
+#define ROLLBACK_MAX_PREDICTORS      4
+
+// Rollbacks by frames replayed, the last bucket counting anything deeper.
+#define ROLLBACK_DEPTH_BUCKETS       (ROLLBACK_MAX_PREDICTION + 2)
+
+// Rollbacks by time taken, bucket n counting those under 2^n microseconds and
+// the last anything longer.
+#define ROLLBACK_COST_BUCKETS        16
+
+typedef struct RollbackSession RollbackSession;
+
+// Guesses the inputs of remote players that haven't arrived yet. observe is
+// told each input of a remote player as it arrives, in frame order. predict
+// then guesses the input frames_ahead frames after the last one observed for
+// the player, which was last_input. Guesses only cost replays when wrong, so
+// peers needn't agree on them.
+typedef struct RollbackPredictor
+{
+	char const *name;
+	void *context;
+	void (*observe)(void *context, int player, void const *input);
+	void (*predict)(
+		void *context,
+		int player,
+		void const *last_input,
+		int frames_ahead,
+		void *input);
+} RollbackPredictor;
+
+// Unreliable, unordered datagrams between this session and its peers, which
+// are numbered by the transport. receive returns the length of the next
+// datagram waiting, or 0 if there is none. now_ms is the transport's clock,
+// so that simulated networks can run on simulated time.
+typedef struct RollbackTransport
+{
+	void *context;
+	void (*send)(void *context, int peer, void const *data, int len);
+	int (*receive)(void *context, int *peer, void *data, int capacity);
+	unsigned int (*now_ms)(void *context);
+} RollbackTransport;
+
+// What one frame cost, from an rollback_advance_frame outside of a rollback to
+// the next. Replaying includes the saves made while replaying.
+typedef struct RollbackFrameTiming
+{
+	int frame;
+	int resimulated;
+	long long save_ticks;
+	long long load_ticks;
+	long long resimulate_ticks;
+	long long poll_ticks;
+} RollbackFrameTiming;
+
+// Frames simulated on a guess of a player's input, counted once the input
+// arrives, and how many of those guesses were wrong.
+typedef struct RollbackPlayerStats
+{
+	long long predictions;
+	long long mispredictions;
+} RollbackPlayerStats;
+
+// How often a predictor was, or would have been, wrong.
+typedef struct RollbackPredictorStats
+{
+	char const *name;
+	long long predictions;
+	long long mispredictions;
+} RollbackPredictorStats;
+
+// Ticks are those of timer.h.
+typedef struct RollbackStats
+{
+	long long frames;
+	long long rollbacks;
+	// Rollbacks the game stopped advancing in before catching up, left out of
+	// the rest.
+	long long failed_rollbacks;
+	long long frames_resimulated;
+	int max_rollback_depth;
+	long long save_ticks;
+	long long load_ticks;
+	long long resimulate_ticks;
+	// Of resimulate_ticks, those spent saving. The rest is the game stepping.
+	long long resimulate_save_ticks;
+	long long poll_ticks;
+	long long depth_histogram[ROLLBACK_DEPTH_BUCKETS];
+	long long cost_histogram[ROLLBACK_COST_BUCKETS];
+	// The local player's input delay, the delay this session proposes, and
+	// how many times the delay agreed on changed, last from which frame.
+	int frame_delay;
+	int proposed_delay;
+	long long delay_changes;
+	int last_delay_change;
+	// How far ahead of its frame the local player's last input went, which
+	// is frame_delay once a change has played out, and the inputs dropped to
+	// bring the delay down.
+	int input_lead;
+	long long inputs_dropped;
+	int num_players;
+	RollbackPlayerStats players[ROLLBACK_MAX_PLAYERS];
+	int num_predictors;
+	RollbackPredictorStats predictors[ROLLBACK_MAX_PREDICTORS];
+	// recent[frame % ROLLBACK_TIMING_FRAMES], for the last frames.
+	RollbackFrameTiming recent[ROLLBACK_TIMING_FRAMES];
+} RollbackStats;
+
+GGPOErrorCode rollback_start_session(
+	RollbackSession **session,
+	GGPOSessionCallbacks const *callbacks,
+	RollbackTransport const *transport,
+	int num_players,
+	int input_size);
+
+// peer is the transport's number for a remote player, ignored otherwise.
+// Spectators aren't supported, and only one player can be local.
+GGPOErrorCode rollback_add_player(
+	RollbackSession *session,
+	GGPOPlayer const *player,
+	int peer,
+	GGPOPlayerHandle *handle);
+
+GGPOErrorCode rollback_close_session(RollbackSession *session);
+
+// Fixes the input delay of the local player.
+GGPOErrorCode rollback_set_frame_delay(
+	RollbackSession *session,
+	GGPOPlayerHandle player,
+	int frame_delay);
+
+// Lets the input delay of the local player follow the round trip time and
+// jitter to the peers and what rollbacks cost, within a range. Peers agree on
+// the delay from what each proposes, so they should all use this, and every
+// change is a frame up or down, taking effect on the same frame on every peer.
+GGPOErrorCode rollback_set_adaptive_frame_delay(
+	RollbackSession *session,
+	GGPOPlayerHandle player,
+	int min_frame_delay,
+	int max_frame_delay);
+
+// Exchanges inputs with the peers and rolls back if a prediction was wrong.
+// Never blocks. Fails if the state to roll back to is no longer saved, or the
+// game stops advancing while replaying.
+GGPOErrorCode rollback_idle(RollbackSession *session);
+
+GGPOErrorCode rollback_add_local_input(
+	RollbackSession *session,
+	GGPOPlayerHandle player,
+	void const *values,
+	int size);
+
+// Fills values with the inputs of every player for the current frame, known
+// or predicted, and zeroes whatever is left of size.
+GGPOErrorCode rollback_synchronize_input(
+	RollbackSession *session,
+	void *values,
+	int size,
+	int *disconnect_flags);
+
+// Every predictor added guesses alongside the one in use, so that how often
+// each would be wrong can be compared. Predictor 0, in use to begin with,
+// repeats the last input.
+GGPOErrorCode rollback_add_predictor(
+	RollbackSession *session,
+	RollbackPredictor const *predictor,
+	int *index);
+
+GGPOErrorCode rollback_use_predictor(RollbackSession *session, int index);
+
+GGPOErrorCode rollback_disconnect_player(
+	RollbackSession *session,
+	GGPOPlayerHandle player);
+
+GGPOErrorCode rollback_advance_frame(RollbackSession *session);
+
+GGPOErrorCode rollback_get_network_stats(
+	RollbackSession *session,
+	GGPOPlayerHandle player,
+	GGPONetworkStats *stats);
+
+GGPOErrorCode rollback_set_disconnect_timeout(
+	RollbackSession *session,
+	int timeout);
+
+GGPOErrorCode rollback_set_disconnect_notify_start(
+	RollbackSession *session,
+	int timeout);
+
+int rollback_frame_number(RollbackSession const *session);
+
+// The last frame for which the inputs of every remote player are known, no
+// later than the current frame. -1 until the first is.
+int rollback_confirmed_frame(RollbackSession const *session);
+
+void rollback_get_stats(RollbackSession const *session, RollbackStats *stats);
+
+// Writes stats as CSV rows of a metric, a key such as a player, a depth or a
+// frame, and a value, with times in nanoseconds.
+void rollback_write_stats(RollbackStats const *stats, FILE *file);
+
+// Returns false if the file can't be written.
+int rollback_export_stats(RollbackStats const *stats, char const *filename);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ifndef _ROLLBACK_H_
@@ -0,0 +1,169 @@
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#define _POSIX_C_SOURCE 200809L
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+#include <stdbool.h>
+#include <string.h>
+#include "rollback_udp.h"
+#include "timer.h"
+
+#ifdef _WIN32
+typedef int socklen_t;
+#define close_socket closesocket
+#else
+typedef int SOCKET;
+#define INVALID_SOCKET (-1)
+#define close_socket close
+#endif
+
+int udp_transport_create(UdpTransport *udp, unsigned short port)
+{
+	memset(udp, 0, sizeof(*udp));
+
+#ifdef _WIN32
+	WSADATA wsa;
+
+	if (WSAStartup(MAKEWORD(2, 2), &wsa))
+	{
+		return false;
+	}
+#endif
+
+	SOCKET s = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+
+	if (s == INVALID_SOCKET)
+	{
+		return false;
+	}
+
+	struct sockaddr_in address;
+	memset(&address, 0, sizeof(address));
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_ANY);
+	address.sin_port = htons(port);
+
+#ifdef _WIN32
+	u_long non_blocking = 1;
+	bool ok = ioctlsocket(s, FIONBIO, &non_blocking) == 0;
+#else
+	bool ok = fcntl(s, F_SETFL, fcntl(s, F_GETFL, 0) | O_NONBLOCK) == 0;
+#endif
+
+	if (!ok || bind(s, (struct sockaddr*)&address, sizeof(address)))
+	{
+		close_socket(s);
+		return false;
+	}
+
+	udp->socket = (uintptr_t)s;
+	udp->ticks_per_ms = timer_ticks_per_second() / 1000;
+
+	return true;
+}
+
+void udp_transport_destroy(UdpTransport *udp)
+{
+	close_socket((SOCKET)udp->socket);
+
+#ifdef _WIN32
+	WSACleanup();
+#endif
+
+	memset(udp, 0, sizeof(*udp));
+}
+
+int udp_transport_add_peer(
+	UdpTransport *udp, char const *ip_address, unsigned short port)
+{
+	struct in_addr address;
+
+	if (udp->num_peers == ROLLBACK_MAX_PLAYERS ||
+		inet_pton(AF_INET, ip_address, &address) != 1)
+	{
+		return -1;
+	}
+
+	udp->addresses[udp->num_peers] = address.s_addr;
+	udp->ports[udp->num_peers] = htons(port);
+
+	return udp->num_peers++;
+}
+
+static void udp_send(void *context, int peer, void const *data, int len)
+{
+	UdpTransport *udp = (UdpTransport*)context;
+	struct sockaddr_in address;
+
+	memset(&address, 0, sizeof(address));
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = udp->addresses[peer];
+	address.sin_port = udp->ports[peer];
+
+	// Dropped when the socket buffer is full, like anything else sent.
+	sendto((SOCKET)udp->socket,
+		(char const*)data,
+		len,
+		0,
+		(struct sockaddr*)&address,
+		sizeof(address));
+}
+
+static int udp_receive(void *context, int *peer, void *data, int capacity)
+{
+	UdpTransport *udp = (UdpTransport*)context;
+
+	for (;;)
+	{
+		struct sockaddr_in address;
+		socklen_t address_len = sizeof(address);
+		int len = (int)recvfrom((SOCKET)udp->socket,
+			(char*)data,
+			capacity,
+			0,
+			(struct sockaddr*)&address,
+			&address_len);
+
+		// Nothing waiting, or an error such as an ICMP port unreachable from
+		// a peer that isn't up yet. Either way, try again next time.
+		if (len <= 0)
+		{
+			return 0;
+		}
+
+		for (int i = 0; i < udp->num_peers; i++)
+		{
+			if (udp->addresses[i] == address.sin_addr.s_addr &&
+				udp->ports[i] == address.sin_port)
+			{
+				*peer = i;
+				return len;
+			}
+		}
+	}
+}
+
+static unsigned int udp_now_ms(void *context)
+{
+	UdpTransport *udp = (UdpTransport*)context;
+
+	return (unsigned int)(timer_ticks() / udp->ticks_per_ms);
+}
+
+RollbackTransport udp_transport_interface(UdpTransport *udp)
+{
+	RollbackTransport transport;
+
+	transport.context = udp;
+	transport.send = udp_send;
+	transport.receive = udp_receive;
+	transport.now_ms = udp_now_ms;
+
+	return transport;
+}
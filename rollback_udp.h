@@ -0,0 +1,41 @@
+#ifndef _ROLLBACK_UDP_H_
+#define _ROLLBACK_UDP_H_
+
+#include <stdint.h>
+#include "rollback.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// A RollbackTransport over a non-blocking IPv4 UDP socket. Peers are numbered
+// in the order they are added, and datagrams from any other address are
+// dropped.
+typedef struct UdpTransport
+{
+	uintptr_t socket;
+	int num_peers;
+	// In network byte order.
+	unsigned int addresses[ROLLBACK_MAX_PLAYERS];
+	unsigned short ports[ROLLBACK_MAX_PLAYERS];
+	long long ticks_per_ms;
+} UdpTransport;
+
+int udp_transport_create(UdpTransport *udp, unsigned short port);
+
+void udp_transport_destroy(UdpTransport *udp);
+
+// Returns the peer number for the address, or -1 if it isn't a dotted IPv4
+// address or there are too many peers.
+int udp_transport_add_peer(
+	UdpTransport *udp,
+	char const *ip_address,
+	unsigned short port);
+
+RollbackTransport udp_transport_interface(UdpTransport *udp);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ifndef _ROLLBACK_UDP_H_
@@ -0,0 +1,176 @@
+#ifndef _SCALAR_H_
+#define _SCALAR_H_
+
+// The number type the simulation runs on. By default a Scalar is a double and
+// trig comes from libm. Defining VECTORWAR_FIXED_POINT makes it a Q16.16 fixed
+// point number with table driven trig instead, so that the game state, and so
+// game_state_hash, is bit-identical no matter the compiler or CPU.
+//
+// Angles are always whole degrees in [0, 360).
+
+#include <math.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifdef VECTORWAR_FIXED_POINT
+
+#define SCALAR_FRACTION_BITS 16
+#define SCALAR_ONE           (1 << SCALAR_FRACTION_BITS)
+
+typedef int Scalar;
+
+// For compile time constants only.
+#define SCALAR(x) ((Scalar)((x) * SCALAR_ONE))
+
+extern const Scalar scalar_cos_table[360];
+extern const Scalar scalar_sin_table[360];
+
+static inline Scalar scalar_from_int(int i)
+{
+	return i * SCALAR_ONE;
+}
+
+static inline double scalar_to_double(Scalar s)
+{
+	return (double)s / SCALAR_ONE;
+}
+
+// Truncates toward zero.
+static inline int scalar_to_int(Scalar s)
+{
+	return s / SCALAR_ONE;
+}
+
+static inline Scalar scalar_mul(Scalar lhs, Scalar rhs)
+{
+	return (Scalar)(((long long)lhs * rhs) >> SCALAR_FRACTION_BITS);
+}
+
+static inline Scalar scalar_div(Scalar lhs, Scalar rhs)
+{
+	return (Scalar)(((long long)lhs * SCALAR_ONE) / rhs);
+}
+
+static inline Scalar scalar_cos(int degrees)
+{
+	return scalar_cos_table[degrees];
+}
+
+static inline Scalar scalar_sin(int degrees)
+{
+	return scalar_sin_table[degrees];
+}
+
+// The sum of squares is kept at Q32.32 so that whole-screen distances don't
+// overflow, whose square root then comes out at Q16.16 again.
+static inline Scalar scalar_length(Scalar x, Scalar y)
+{
+	unsigned long long n =
+		(unsigned long long)((long long)x * x + (long long)y * y);
+	unsigned long long root = 0;
+	unsigned long long bit = 1ull << 62;
+
+	while (bit > n)
+	{
+		bit >>= 2;
+	}
+
+	while (bit)
+	{
+		if (n >= root + bit)
+		{
+			n -= root + bit;
+			root = (root >> 1) + bit;
+		}
+		else
+		{
+			root >>= 1;
+		}
+
+		bit >>= 2;
+	}
+
+	return (Scalar)root;
+}
+
+// Compares squares, so no root is taken.
+static inline int scalar_length_less(Scalar x, Scalar y, Scalar bound)
+{
+	return (long long)x * x + (long long)y * y < (long long)bound * bound;
+}
+
+// For drawing only, as it goes through a double.
+static inline Scalar scalar_lerp(Scalar from, Scalar to, double t)
+{
+	return from + (Scalar)((to - from) * t);
+}
+
+#else
+
+typedef double Scalar;
+
+#define SCALAR(x) ((Scalar)(x))
+
+#define SCALAR_PI ((double)3.1415926)
+
+static inline Scalar scalar_from_int(int i)
+{
+	return (Scalar)i;
+}
+
+static inline double scalar_to_double(Scalar s)
+{
+	return s;
+}
+
+// Truncates toward zero.
+static inline int scalar_to_int(Scalar s)
+{
+	return (int)s;
+}
+
+static inline Scalar scalar_mul(Scalar lhs, Scalar rhs)
+{
+	return lhs * rhs;
+}
+
+static inline Scalar scalar_div(Scalar lhs, Scalar rhs)
+{
+	return lhs / rhs;
+}
+
+static inline Scalar scalar_cos(int degrees)
+{
+	return cos(SCALAR_PI * degrees / 180);
+}
+
+static inline Scalar scalar_sin(int degrees)
+{
+	return sin(SCALAR_PI * degrees / 180);
+}
+
+static inline Scalar scalar_length(Scalar x, Scalar y)
+{
+	return sqrt(x * x + y * y);
+}
+
+// Compares squares, so no root is taken.
+static inline int scalar_length_less(Scalar x, Scalar y, Scalar bound)
+{
+	return x * x + y * y < bound * bound;
+}
+
+static inline Scalar scalar_lerp(Scalar from, Scalar to, double t)
+{
+	return from + (to - from) * t;
+}
+
+#endif // ifdef VECTORWAR_FIXED_POINT
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ifndef _SCALAR_H_
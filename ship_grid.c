@@ -0,0 +1,190 @@
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ship_grid.h"
+
+static int cell_coordinate(Scalar offset, int cell_size, int cells)
+{
+	int pixels = scalar_to_int(offset);
+
+	if (pixels < 0)
+	{
+		return 0;
+	}
+
+	return pixels / cell_size < cells ? pixels / cell_size : cells - 1;
+}
+
+static void cell_of(ShipGrid const *grid, Scalar x, Scalar y, int *cx, int *cy)
+{
+	// Spares the divisions when there's just the one cell.
+	if (grid->columns == 1 && grid->rows == 1)
+	{
+		*cx = *cy = 0;
+		return;
+	}
+
+	*cx = cell_coordinate(x - grid->left, grid->cell_size, grid->columns);
+	*cy = cell_coordinate(y - grid->top, grid->cell_size, grid->rows);
+}
+
+int ship_grid_create(ShipGrid *grid, int max_ships)
+{
+	memset(grid, 0, sizeof(*grid));
+
+	grid->cell_ships = (int*)malloc(sizeof(int) * max_ships);
+	grid->ship_cells = (int*)malloc(sizeof(int) * max_ships);
+
+	if (!grid->cell_ships || !grid->ship_cells)
+	{
+		ship_grid_destroy(grid);
+		return false;
+	}
+
+	return true;
+}
+
+void ship_grid_destroy(ShipGrid *grid)
+{
+	free(grid->cell_ships);
+	free(grid->ship_cells);
+	grid->cell_ships = NULL;
+	grid->ship_cells = NULL;
+}
+
+void ship_grid_build(
+	ShipGrid *grid, Ship const *ships, int num_ships, Bounds const *bounds)
+{
+	int max_radius = 1;
+
+	for (int i = 0; i < num_ships; i++)
+	{
+		if (ships[i].radius > max_radius)
+		{
+			max_radius = ships[i].radius;
+		}
+	}
+
+	int width = bounds->right - bounds->left + 1;
+	int height = bounds->bottom - bounds->top + 1;
+
+	width = width < 1 ? 1 : width;
+	height = height < 1 ? 1 : height;
+
+	int cell_size = max_radius;
+
+	if (num_ships < SHIP_GRID_MIN_SHIPS)
+	{
+		cell_size = width > height ? width : height;
+	}
+
+	while (((width + cell_size - 1) / cell_size) *
+		((height + cell_size - 1) / cell_size) > SHIP_GRID_MAX_CELLS)
+	{
+		cell_size *= 2;
+	}
+
+	grid->left = scalar_from_int(bounds->left);
+	grid->top = scalar_from_int(bounds->top);
+	grid->cell_size = cell_size;
+	grid->columns = (width + cell_size - 1) / cell_size;
+	grid->rows = (height + cell_size - 1) / cell_size;
+	grid->num_ships = num_ships;
+
+	int num_cells = grid->columns * grid->rows;
+
+	memset(grid->cell_start, 0, sizeof(int) * (num_cells + 1));
+
+	// Counting sort by cell. Visiting ships in order keeps every cell sorted.
+	for (int i = 0; i < num_ships; i++)
+	{
+		int cx, cy;
+		cell_of(grid, ships[i].position.x, ships[i].position.y, &cx, &cy);
+
+		grid->ship_cells[i] = cy * grid->columns + cx;
+		grid->cell_start[grid->ship_cells[i] + 1]++;
+	}
+
+	for (int c = 1; c <= num_cells; c++)
+	{
+		grid->cell_start[c] += grid->cell_start[c - 1];
+	}
+
+	for (int i = 0; i < num_ships; i++)
+	{
+		grid->cell_ships[grid->cell_start[grid->ship_cells[i]]++] = i;
+	}
+
+	// Filling advanced every start to the start of the next cell.
+	for (int c = num_cells; c > 0; c--)
+	{
+		grid->cell_start[c] = grid->cell_start[c - 1];
+	}
+
+	grid->cell_start[0] = 0;
+}
+
+static int contains(Ship const *ship, Scalar x, Scalar y)
+{
+	return scalar_length_less(
+		ship->position.x - x,
+		ship->position.y - y,
+		scalar_from_int(ship->radius));
+}
+
+int ship_grid_first_hit(
+	ShipGrid const *grid, Ship const *ships, Scalar x, Scalar y)
+{
+	if (grid->columns == 1 && grid->rows == 1)
+	{
+		for (int j = 0; j < grid->num_ships; j++)
+		{
+			if (contains(ships + j, x, y))
+			{
+				return j;
+			}
+		}
+
+		return -1;
+	}
+
+	int cx, cy, hit = -1;
+	cell_of(grid, x, y, &cx, &cy);
+
+	for (int gy = cy - 1; gy <= cy + 1; gy++)
+	{
+		if (gy < 0 || gy >= grid->rows)
+		{
+			continue;
+		}
+
+		for (int gx = cx - 1; gx <= cx + 1; gx++)
+		{
+			if (gx < 0 || gx >= grid->columns)
+			{
+				continue;
+			}
+
+			int c = gy * grid->columns + gx;
+
+			for (int k = grid->cell_start[c]; k < grid->cell_start[c + 1]; k++)
+			{
+				int j = grid->cell_ships[k];
+				Ship const *ship = ships + j;
+
+				if (hit >= 0 && j > hit)
+				{
+					break;
+				}
+
+				if (contains(ship, x, y))
+				{
+					hit = j;
+					break;
+				}
+			}
+		}
+	}
+
+	return hit;
+}
@@ -0,0 +1,54 @@
+#ifndef _SHIP_GRID_H_
+#define _SHIP_GRID_H_
+
+#include "game_state.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SHIP_GRID_MAX_CELLS 4096
+
+// Below this many ships a single cell, i.e. testing all of them, is cheaper
+// than clearing the grid.
+#define SHIP_GRID_MIN_SHIPS    8
+
+// A uniform grid over the bounds, bucketing ships by the cell their center is
+// in. Cells are at least as large as the largest ship radius, so anything
+// within reach of a point is in the 3x3 cells around it.
+typedef struct ShipGrid
+{
+	Scalar left, top;
+	int cell_size;
+	int columns, rows;
+	int num_ships;
+	// Ships of cell c are cell_ships[cell_start[c]] up to, but not including,
+	// cell_ships[cell_start[c + 1]], in ascending order.
+	int cell_start[SHIP_GRID_MAX_CELLS + 1];
+	int *cell_ships;
+	int *ship_cells;
+} ShipGrid;
+
+int ship_grid_create(ShipGrid *grid, int max_ships);
+
+void ship_grid_destroy(ShipGrid *grid);
+
+void ship_grid_build(
+	ShipGrid *grid,
+	Ship const *ships,
+	int num_ships,
+	Bounds const *bounds);
+
+// The lowest numbered ship whose radius contains the point, or -1. Same answer
+// as testing every ship in order.
+int ship_grid_first_hit(
+	ShipGrid const *grid,
+	Ship const *ships,
+	Scalar x,
+	Scalar y);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ifndef _SHIP_GRID_H_
@@ -0,0 +1,61 @@
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "silhouette.h"
+
+#define PI 3.14159265358979323846
+
+int silhouette_create(
+	Silhouette *silhouette, SilhouettePoint const *shape, int count)
+{
+	memset(silhouette, 0, sizeof(*silhouette));
+
+	silhouette->rotations = (SilhouettePoint*)malloc(
+		sizeof(SilhouettePoint) * SILHOUETTE_HEADINGS * count);
+
+	if (!silhouette->rotations)
+	{
+		return false;
+	}
+
+	silhouette->shape = shape;
+	silhouette->count = count;
+
+	return true;
+}
+
+void silhouette_destroy(Silhouette *silhouette)
+{
+	free(silhouette->rotations);
+	memset(silhouette, 0, sizeof(*silhouette));
+}
+
+SilhouettePoint const *silhouette_at(Silhouette *silhouette, int heading)
+{
+	heading = (heading % SILHOUETTE_HEADINGS + SILHOUETTE_HEADINGS) %
+		SILHOUETTE_HEADINGS;
+
+	SilhouettePoint *rotated =
+		silhouette->rotations + heading * silhouette->count;
+
+	if (!silhouette->built[heading])
+	{
+		double theta = heading * 2 * PI / SILHOUETTE_HEADINGS;
+		double c = cos(theta);
+		double s = sin(theta);
+
+		for (int i = 0; i < silhouette->count; i++)
+		{
+			SilhouettePoint p = silhouette->shape[i];
+
+			rotated[i].x = (float)(p.x * c - p.y * s);
+			rotated[i].y = (float)(p.x * s + p.y * c);
+		}
+
+		silhouette->built[heading] = true;
+		silhouette->headings_built++;
+	}
+
+	return rotated;
+}
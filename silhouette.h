@@ -0,0 +1,43 @@
+#ifndef _SILHOUETTE_H_
+#define _SILHOUETTE_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Headings are whole degrees.
+#define SILHOUETTE_HEADINGS 360
+
+typedef struct SilhouettePoint
+{
+	float x, y;
+} SilhouettePoint;
+
+// A shape, about its origin and pointing along the x axis, and its rotations
+// to every heading, each worked out the first time it is asked for. Drawing
+// the shape is then a lookup and a translation.
+typedef struct Silhouette
+{
+	SilhouettePoint const *shape;
+	int count;
+	// count points per heading.
+	SilhouettePoint *rotations;
+	unsigned char built[SILHOUETTE_HEADINGS];
+	int headings_built;
+} Silhouette;
+
+// Keeps shape, which must outlive the silhouette. Returns false if out of
+// memory.
+int silhouette_create(
+	Silhouette *silhouette, SilhouettePoint const *shape, int count);
+
+void silhouette_destroy(Silhouette *silhouette);
+
+// The count points of the shape turned to heading, in degrees, any of them.
+SilhouettePoint const *silhouette_at(Silhouette *silhouette, int heading);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ifndef _SILHOUETTE_H_
@@ -0,0 +1,266 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "checksum.h"
+#include "game.h"
+#include "game_state.h"
+#include "timer.h"
+
+// Times the callbacks GGPO hammers during rollback, one call at a time, and
+// reports their latency distributions. The calls follow the pattern of a
+// session: every frame is stepped, saved and checksummed, the oldest save
+// still held is loaded as a rollback would, and saves are freed once more
+// than a prediction window's worth are outstanding. Also reports how much
+// memory the held saves take.
+
+#define ARENA_WIDTH     640
+#define ARENA_HEIGHT    480
+#define WARM_UP_FRAMES  600
+#define OUTSTANDING     10
+
+enum CALLBACK
+{
+	CALLBACK_save,
+	CALLBACK_checksum,
+	CALLBACK_load,
+	CALLBACK_free,
+	CALLBACK_count,
+};
+
+static const char *callback_names[CALLBACK_count] =
+{
+	"save_game_state",
+	"compute_checksum",
+	"load_game_state",
+	"free_game_state",
+};
+
+typedef struct Samples
+{
+	long long *ticks;
+	int count;
+} Samples;
+
+static const int ship_counts[] = { 4, 16, 64, 256, 1024 };
+
+static int compare_ticks(void const *lhs, void const *rhs)
+{
+	long long l = *(long long const*)lhs;
+	long long r = *(long long const*)rhs;
+	return (l > r) - (l < r);
+}
+
+static double percentile(Samples const *samples, double p)
+{
+	int i = (int)(p * (samples->count - 1) + 0.5);
+	return timer_ticks_to_ns(samples->ticks[i]);
+}
+
+static void report(
+	int num_ships, int max_bullets, int size, Samples *samples)
+{
+	for (int c = 0; c < CALLBACK_count; c++)
+	{
+		qsort(samples[c].ticks,
+			samples[c].count,
+			sizeof(long long),
+			compare_ticks);
+
+		printf("%6d %7d %8d  %-20s %9.0f %9.0f %9.0f %9.0f\n",
+			num_ships,
+			max_bullets,
+			size,
+			callback_names[c],
+			percentile(&samples[c], 0.5),
+			percentile(&samples[c], 0.99),
+			percentile(&samples[c], 0.999),
+			percentile(&samples[c], 1.0));
+	}
+}
+
+static int parse_checksum(char const *name, enum CHECKSUM *kind)
+{
+	if (!strcmp(name, "fletcher32"))
+	{
+		*kind = CHECKSUM_fletcher32;
+		return true;
+	}
+
+	if (!strcmp(name, "stripe"))
+	{
+		*kind = CHECKSUM_stripe;
+		return true;
+	}
+
+	return false;
+}
+
+static void step(LocalInput *inputs, int num_ships, unsigned int *random)
+{
+	for (int i = 0; i < num_ships; i++)
+	{
+		*random = *random * 1103515245u + 12345u;
+		inputs[i].inputs = (int)((*random >> 16) & 0x3f);
+	}
+
+	step_game(inputs, 0);
+}
+
+static void free_samples(Samples *samples)
+{
+	for (int c = 0; c < CALLBACK_count; c++)
+	{
+		free(samples[c].ticks);
+	}
+}
+
+static int run(
+	int num_ships,
+	int max_bullets,
+	int iterations,
+	enum CHECKSUM kind,
+	int keyframes)
+{
+	LocalInput *inputs = (LocalInput*)calloc(num_ships, sizeof(LocalInput));
+	Samples samples[CALLBACK_count];
+	unsigned char *outstanding[OUTSTANDING + 1];
+	int num_outstanding = 0;
+	unsigned int random = 1;
+	bool allocated = inputs != NULL;
+
+	for (int c = 0; c < CALLBACK_count; c++)
+	{
+		samples[c].ticks = (long long*)malloc(sizeof(long long) * iterations);
+		samples[c].count = 0;
+		allocated = allocated && samples[c].ticks;
+	}
+
+	if (!allocated || !setup_game(
+		ARENA_WIDTH, ARENA_HEIGHT, num_ships, max_bullets))
+	{
+		free_samples(samples);
+		free(inputs);
+		return false;
+	}
+
+	game_set_checksum(kind);
+
+	if (!game_set_snapshot_keyframes(keyframes))
+	{
+		tear_down_game();
+		free_samples(samples);
+		free(inputs);
+		return false;
+	}
+
+	// Get some bullets flying before measuring.
+	for (int i = 0; i < WARM_UP_FRAMES; i++)
+	{
+		step(inputs, num_ships, &random);
+	}
+
+	for (int i = 0; i < iterations; i++)
+	{
+		unsigned char *buffer;
+		int len, checksum;
+		long long start;
+
+		step(inputs, num_ships, &random);
+
+		start = timer_ticks();
+		save_game_state(&buffer, &len, &checksum, game_frame_number());
+		samples[CALLBACK_save].ticks[i] = timer_ticks() - start;
+
+		start = timer_ticks();
+		checksum = compute_checksum(kind, game_state(), len);
+		samples[CALLBACK_checksum].ticks[i] = timer_ticks() - start;
+
+		outstanding[num_outstanding++] = buffer;
+
+		// Roll back as far as possible, then carry on from the newest.
+		start = timer_ticks();
+		load_game_state(outstanding[0], len);
+		samples[CALLBACK_load].ticks[i] = timer_ticks() - start;
+
+		load_game_state(buffer, len);
+
+		if (num_outstanding > OUTSTANDING)
+		{
+			start = timer_ticks();
+			free_game_state(outstanding[0]);
+			samples[CALLBACK_free].ticks[samples[CALLBACK_free].count++] =
+				timer_ticks() - start;
+
+			num_outstanding--;
+			memmove(outstanding,
+				outstanding + 1,
+				sizeof(outstanding[0]) * num_outstanding);
+		}
+	}
+
+	samples[CALLBACK_save].count = iterations;
+	samples[CALLBACK_checksum].count = iterations;
+	samples[CALLBACK_load].count = iterations;
+
+	SnapshotStats stats;
+	game_snapshot_stats(&stats);
+
+	report(num_ships, max_bullets, game_state()->size, samples);
+
+	printf("%6d %7d %8d  %-20s %d frames, %lld bytes each\n",
+		num_ships,
+		max_bullets,
+		game_state()->size,
+		"retained",
+		stats.retained_frames,
+		stats.retained_bytes / stats.retained_frames);
+
+	for (int i = 0; i < num_outstanding; i++)
+	{
+		free_game_state(outstanding[i]);
+	}
+
+	tear_down_game();
+	free_samples(samples);
+	free(inputs);
+
+	return true;
+}
+
+int main(int argc, char *args[])
+{
+	int iterations = argc > 1 ? atoi(args[1]) : 100000;
+	int max_bullets = argc > 2 ? atoi(args[2]) : DEFAULT_MAX_BULLETS;
+	char const *name = argc > 3 ? args[3] : "fletcher32";
+	int keyframes = argc > 4 ? atoi(args[4]) : 0;
+	enum CHECKSUM kind;
+
+	if (iterations <= OUTSTANDING ||
+		max_bullets <= 0 ||
+		keyframes < 0 ||
+		!parse_checksum(name, &kind))
+	{
+		fprintf(stderr,
+			"Syntax: snapshot_bench [iterations] [bullets] "
+			"[fletcher32|stripe] [keyframes]\n");
+		return 1;
+	}
+
+	printf("checksum: %s, keyframes: %d\n", name, keyframes);
+
+	printf("%6s %7s %8s  %-20s %9s %9s %9s %9s\n",
+		"ships", "bullets", "bytes", "call",
+		"p50 ns", "p99 ns", "p999 ns", "max ns");
+
+	for (size_t i = 0; i < sizeof ship_counts / sizeof ship_counts[0]; i++)
+	{
+		if (!run(ship_counts[i], max_bullets, iterations, kind, keyframes))
+		{
+			fprintf(stderr, "Out of memory.\n");
+			return 1;
+		}
+	}
+
+	return 0;
+}
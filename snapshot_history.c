@@ -0,0 +1,285 @@
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "snapshot_history.h"
+
+// Gaps of unchanged words shorter than this are cheaper to store as literals
+// than to end the run for.
+#define MIN_GAP 3
+
+typedef struct SnapshotEntry
+{
+	struct SnapshotEntry *parent;
+	int refs;
+	// Deltas back to the keyframe, 0 for a keyframe.
+	int depth;
+	int size;
+	// The whole state for a keyframe. Otherwise runs of a count of unchanged
+	// words, a count of changed ones and the changed ones XORed with the
+	// parent's.
+	unsigned int data[];
+} SnapshotEntry;
+
+int snapshot_history_create(
+	SnapshotHistory *history, int state_size, int keyframe_interval)
+{
+	memset(history, 0, sizeof(*history));
+
+	history->state_size = state_size;
+	history->keyframe_interval = keyframe_interval;
+	history->reference = (unsigned char*)malloc(state_size);
+	history->scratch = (unsigned char*)malloc(state_size);
+	history->chain = (SnapshotEntry**)malloc(
+		sizeof(SnapshotEntry*) * keyframe_interval);
+
+	if (!history->reference || !history->scratch || !history->chain)
+	{
+		snapshot_history_destroy(history);
+		return false;
+	}
+
+	return true;
+}
+
+void snapshot_history_destroy(SnapshotHistory *history)
+{
+	if (history->last)
+	{
+		snapshot_history_release(history, (unsigned char*)history->last);
+	}
+
+	free(history->reference);
+	free(history->scratch);
+	free(history->chain);
+	memset(history, 0, sizeof(*history));
+}
+
+// XORs state into the reference, leaving the reference equal to state, and
+// encodes the difference into out. Gives up, returning -1, once the encoding
+// would be no smaller than a keyframe.
+static int encode_delta(
+	unsigned int const *state,
+	unsigned int *reference,
+	unsigned int *out,
+	int words)
+{
+	int n = 0, i = 0;
+
+	while (i < words)
+	{
+		int skip = 0;
+
+		while (i < words && state[i] == reference[i])
+		{
+			skip++;
+			i++;
+		}
+
+		if (i == words)
+		{
+			break;
+		}
+
+		if (n + 2 >= words)
+		{
+			return -1;
+		}
+
+		int header = n;
+		int count = 0;
+		n += 2;
+
+		while (i < words)
+		{
+			int gap = 0;
+
+			while (gap < MIN_GAP &&
+				i + gap < words &&
+				state[i + gap] == reference[i + gap])
+			{
+				gap++;
+			}
+
+			if (gap == MIN_GAP || i + gap == words)
+			{
+				break;
+			}
+
+			if (n + gap + 1 >= words)
+			{
+				return -1;
+			}
+
+			for (int g = 0; g <= gap; g++, i++)
+			{
+				out[n++] = state[i] ^ reference[i];
+				reference[i] = state[i];
+			}
+
+			count += gap + 1;
+		}
+
+		out[header] = (unsigned int)skip;
+		out[header + 1] = (unsigned int)count;
+	}
+
+	return n;
+}
+
+static void apply_delta(SnapshotEntry const *entry, unsigned int *state)
+{
+	unsigned int const *p = entry->data;
+	unsigned int const *end = p + entry->size / 4;
+	unsigned int *word = state;
+
+	while (p < end)
+	{
+		word += p[0];
+		unsigned int count = p[1];
+		p += 2;
+
+		for (unsigned int k = 0; k < count; k++)
+		{
+			*word++ ^= *p++;
+		}
+	}
+}
+
+static SnapshotEntry *new_entry(
+	SnapshotHistory *history,
+	SnapshotEntry *parent,
+	void const *data,
+	int size)
+{
+	SnapshotEntry *entry =
+		(SnapshotEntry*)malloc(sizeof(SnapshotEntry) + size);
+
+	if (!entry)
+	{
+		return NULL;
+	}
+
+	entry->parent = parent;
+	entry->refs = 1;
+	entry->depth = parent ? parent->depth + 1 : 0;
+	entry->size = size;
+	memcpy(entry->data, data, size);
+
+	if (parent)
+	{
+		parent->refs++;
+	}
+
+	history->retained_frames++;
+	history->retained_bytes += sizeof(SnapshotEntry) + size;
+
+	return entry;
+}
+
+static void make_last(SnapshotHistory *history, SnapshotEntry *entry)
+{
+	entry->refs++;
+
+	if (history->last)
+	{
+		snapshot_history_release(history, (unsigned char*)history->last);
+	}
+
+	history->last = entry;
+}
+
+unsigned char *snapshot_history_save(
+	SnapshotHistory *history, void const *state)
+{
+	SnapshotEntry *entry = NULL;
+	SnapshotEntry *last = history->last;
+
+	if (last && last->depth + 1 < history->keyframe_interval)
+	{
+		int words = encode_delta(
+			(unsigned int const*)state,
+			(unsigned int*)history->reference,
+			(unsigned int*)history->scratch,
+			history->state_size / 4);
+
+		if (words >= 0)
+		{
+			entry = new_entry(history, last, history->scratch, words * 4);
+
+			if (!entry)
+			{
+				return NULL;
+			}
+		}
+	}
+
+	if (!entry)
+	{
+		memcpy(history->reference, state, history->state_size);
+		entry = new_entry(history, NULL, state, history->state_size);
+
+		if (!entry)
+		{
+			return NULL;
+		}
+	}
+
+	make_last(history, entry);
+
+	return (unsigned char*)entry;
+}
+
+void snapshot_history_restore(
+	SnapshotHistory const *history, unsigned char const *handle, void *state)
+{
+	SnapshotEntry const *entry = (SnapshotEntry const*)handle;
+
+	if (entry == history->last)
+	{
+		memcpy(state, history->reference, history->state_size);
+		return;
+	}
+
+	int n = 0;
+
+	for (; entry->parent; entry = entry->parent)
+	{
+		history->chain[n++] = (SnapshotEntry*)entry;
+	}
+
+	memcpy(state, entry->data, history->state_size);
+
+	while (n)
+	{
+		apply_delta(history->chain[--n], (unsigned int*)state);
+	}
+}
+
+void snapshot_history_load(
+	SnapshotHistory *history, unsigned char const *handle, void *state)
+{
+	snapshot_history_restore(history, handle, state);
+
+	if ((SnapshotEntry const*)handle != history->last)
+	{
+		memcpy(history->reference, state, history->state_size);
+		make_last(history, (SnapshotEntry*)handle);
+	}
+}
+
+void snapshot_history_release(
+	SnapshotHistory *history, unsigned char *handle)
+{
+	SnapshotEntry *entry = (SnapshotEntry*)handle;
+
+	while (entry && --entry->refs == 0)
+	{
+		SnapshotEntry *parent = entry->parent;
+
+		history->retained_frames--;
+		history->retained_bytes -= sizeof(SnapshotEntry) + entry->size;
+
+		free(entry);
+		entry = parent;
+	}
+}
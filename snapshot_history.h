@@ -0,0 +1,67 @@
+#ifndef _SNAPSHOT_HISTORY_H_
+#define _SNAPSHOT_HISTORY_H_
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SNAPSHOT_HISTORY_DEFAULT_KEYFRAMES 8
+
+struct SnapshotEntry;
+
+// Saved game states as a full copy every keyframe_interval saves, with XOR
+// deltas against the state saved or loaded just before in between, run
+// length encoded by 4 byte word. An entry stays around for as long as it is
+// handed out or some later delta is based on it, so entries can be released
+// in any order. Memory then grows with how much changes per frame, rather
+// than with the state size times the length of the window.
+typedef struct SnapshotHistory
+{
+	int state_size;
+	int keyframe_interval;
+	// The state of last, which the next save is a delta against.
+	unsigned char *reference;
+	unsigned char *scratch;
+	struct SnapshotEntry *last;
+	struct SnapshotEntry **chain;
+	int retained_frames;
+	long long retained_bytes;
+} SnapshotHistory;
+
+// state_size must be a multiple of 4.
+int snapshot_history_create(
+	SnapshotHistory *history,
+	int state_size,
+	int keyframe_interval);
+
+void snapshot_history_destroy(SnapshotHistory *history);
+
+// Returns a handle to the saved state, or NULL if out of memory.
+unsigned char *snapshot_history_save(
+	SnapshotHistory *history,
+	void const *state);
+
+// Rebuilds a saved state into state, which becomes the base of the next
+// delta.
+void snapshot_history_load(
+	SnapshotHistory *history,
+	unsigned char const *handle,
+	void *state);
+
+// Rebuilds a saved state into state and leaves the history as it is.
+void snapshot_history_restore(
+	SnapshotHistory const *history,
+	unsigned char const *handle,
+	void *state);
+
+void snapshot_history_release(
+	SnapshotHistory *history,
+	unsigned char *handle);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ifndef _SNAPSHOT_HISTORY_H_
@@ -0,0 +1,117 @@
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "snapshot_ring.h"
+
+#define SLOT_ALIGNMENT 64
+
+// size must be a multiple of SLOT_ALIGNMENT.
+static unsigned char *alloc_slots(size_t size)
+{
+#ifdef _WIN32
+	return (unsigned char*)_aligned_malloc(size, SLOT_ALIGNMENT);
+#else
+	return (unsigned char*)aligned_alloc(SLOT_ALIGNMENT, size);
+#endif
+}
+
+static void free_slots(unsigned char *slots)
+{
+#ifdef _WIN32
+	_aligned_free(slots);
+#else
+	free(slots);
+#endif
+}
+
+int snapshot_ring_create(SnapshotRing *ring, size_t slot_size)
+{
+	memset(ring, 0, sizeof(*ring));
+
+	// Keep every slot on its own cache lines, starting on a line and taking
+	// up whole lines.
+	ring->slot_size =
+		(slot_size + SLOT_ALIGNMENT - 1) & ~(size_t)(SLOT_ALIGNMENT - 1);
+
+	ring->slots = alloc_slots(ring->slot_size * SNAPSHOT_RING_CAPACITY);
+
+	if (!ring->slots)
+	{
+		ring->slot_size = 0;
+		return false;
+	}
+
+	return true;
+}
+
+void snapshot_ring_destroy(SnapshotRing *ring)
+{
+	free_slots(ring->slots);
+	memset(ring, 0, sizeof(*ring));
+}
+
+static int find_free_slot(SnapshotRing const *ring, int frame)
+{
+	int preferred = frame & (SNAPSHOT_RING_CAPACITY - 1);
+
+	for (int i = 0; i < SNAPSHOT_RING_CAPACITY; i++)
+	{
+		int slot = (preferred + i) & (SNAPSHOT_RING_CAPACITY - 1);
+
+		if (!ring->in_use[slot])
+		{
+			return slot;
+		}
+	}
+
+	return -1;
+}
+
+unsigned char *snapshot_ring_acquire(
+	SnapshotRing *ring, int frame, size_t size)
+{
+	if (size <= ring->slot_size)
+	{
+		int slot = find_free_slot(ring, frame);
+
+		if (slot >= 0)
+		{
+			ring->in_use[slot] = true;
+			ring->allocations_avoided++;
+			ring->outstanding++;
+
+			return ring->slots + slot * ring->slot_size;
+		}
+	}
+
+	unsigned char *buffer = (unsigned char*)malloc(size);
+
+	if (buffer)
+	{
+		ring->heap_allocations++;
+		ring->outstanding++;
+	}
+
+	return buffer;
+}
+
+void snapshot_ring_release(SnapshotRing *ring, void *buffer)
+{
+	unsigned char *p = (unsigned char*)buffer;
+	unsigned char *end = ring->slots +
+		ring->slot_size * SNAPSHOT_RING_CAPACITY;
+
+	ring->outstanding--;
+
+	if (ring->slots && p >= ring->slots && p < end)
+	{
+		ring->in_use[(p - ring->slots) / ring->slot_size] = false;
+		return;
+	}
+
+	free(buffer);
+}
@@ -0,0 +1,44 @@
+#ifndef _SNAPSHOT_RING_H_
+#define _SNAPSHOT_RING_H_
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Enough to cover GGPO_MAX_PREDICTION_FRAMES plus the frames GGPO keeps
+// around while confirming. Must be a power of two.
+#define SNAPSHOT_RING_CAPACITY 16
+
+// A fixed number of preallocated, equally sized slots for saved game states.
+// A snapshot of frame n prefers slot n % SNAPSHOT_RING_CAPACITY, so in steady
+// state a slot is reused by the frame that evicted its previous occupant.
+// When no slot is free, falls back to the heap.
+typedef struct SnapshotRing
+{
+	unsigned char *slots;
+	size_t slot_size;
+	int in_use[SNAPSHOT_RING_CAPACITY];
+	long long allocations_avoided;
+	long long heap_allocations;
+	// Slots and heap buffers handed out and not yet released.
+	int outstanding;
+} SnapshotRing;
+
+int snapshot_ring_create(SnapshotRing *ring, size_t slot_size);
+
+void snapshot_ring_destroy(SnapshotRing *ring);
+
+unsigned char *snapshot_ring_acquire(
+	SnapshotRing *ring,
+	int frame,
+	size_t size);
+
+void snapshot_ring_release(SnapshotRing *ring, void *buffer);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ifndef _SNAPSHOT_RING_H_
@@ -0,0 +1,114 @@
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "checksum.h"
+#include "state_hash.h"
+
+#define MODULUS 65535
+
+static int reduce(long long x)
+{
+	x %= MODULUS;
+	return (int)(x < 0 ? x + MODULUS : x);
+}
+
+int state_hash_create(StateHash *hash, int size)
+{
+	memset(hash, 0, sizeof(*hash));
+
+	hash->size = size;
+	hash->num_blocks =
+		(size + STATE_HASH_BLOCK_SIZE - 1) / STATE_HASH_BLOCK_SIZE;
+
+	int words = (hash->num_blocks + 31) / 32;
+
+	hash->sums = (int*)calloc(hash->num_blocks, sizeof(int));
+	hash->weighted = (int*)calloc(hash->num_blocks, sizeof(int));
+	hash->dirty = (unsigned int*)calloc(words, sizeof(unsigned int));
+
+	if (!hash->sums || !hash->weighted || !hash->dirty)
+	{
+		state_hash_destroy(hash);
+		return false;
+	}
+
+	state_hash_mark_all(hash);
+
+	return true;
+}
+
+void state_hash_destroy(StateHash *hash)
+{
+	free(hash->sums);
+	free(hash->weighted);
+	free(hash->dirty);
+	memset(hash, 0, sizeof(*hash));
+}
+
+void state_hash_mark(StateHash *hash, size_t offset, size_t len)
+{
+	if (!len)
+	{
+		return;
+	}
+
+	int first = (int)(offset / STATE_HASH_BLOCK_SIZE);
+	int last = (int)((offset + len - 1) / STATE_HASH_BLOCK_SIZE);
+
+	for (int b = first; b <= last; b++)
+	{
+		hash->dirty[b / 32] |= 1u << (b % 32);
+	}
+}
+
+void state_hash_mark_all(StateHash *hash)
+{
+	for (int b = 0; b < hash->num_blocks; b++)
+	{
+		hash->dirty[b / 32] |= 1u << (b % 32);
+	}
+}
+
+// Word i of n is weighted n - i in the whole buffer, which is its weight
+// within its block plus the number of words after the block.
+static void rehash_block(StateHash *hash, short const *words, int b)
+{
+	int total = hash->size / 2;
+	int first = b * (STATE_HASH_BLOCK_SIZE / 2);
+	int len = total - first < STATE_HASH_BLOCK_SIZE / 2
+		? total - first
+		: STATE_HASH_BLOCK_SIZE / 2;
+
+	int sum, weighted;
+	fletcher32_block_sums(words + first, len, &sum, &weighted);
+
+	sum = reduce(sum);
+	weighted = reduce(weighted + (long long)(total - first - len) * sum);
+
+	hash->sum = reduce((long long)hash->sum - hash->sums[b] + sum);
+	hash->weighted_sum = reduce(
+		(long long)hash->weighted_sum - hash->weighted[b] + weighted);
+
+	hash->sums[b] = sum;
+	hash->weighted[b] = weighted;
+}
+
+int state_hash_value(StateHash *hash, void const *data)
+{
+	for (int w = 0; w < (hash->num_blocks + 31) / 32; w++)
+	{
+		unsigned int dirty = hash->dirty[w];
+
+		for (int bit = 0; bit < 32 && (dirty >> bit); bit++)
+		{
+			if ((dirty >> bit) & 1)
+			{
+				rehash_block(hash, (short const*)data, w * 32 + bit);
+			}
+		}
+
+		hash->dirty[w] = 0;
+	}
+
+	return hash->weighted_sum << 16 | hash->sum;
+}
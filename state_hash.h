@@ -0,0 +1,44 @@
+#ifndef _STATE_HASH_H_
+#define _STATE_HASH_H_
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// In bytes. At most FLETCHER32_BLOCK words.
+#define STATE_HASH_BLOCK_SIZE 512
+
+// A Fletcher-32 of a buffer, taken mod 65535 so that it can be assembled from
+// per block sums, kept up to date by rehashing only the blocks marked dirty
+// since the last time it was asked for.
+typedef struct StateHash
+{
+	int size;
+	int num_blocks;
+	// Each block's share of the totals, mod 65535.
+	int *sums;
+	int *weighted;
+	unsigned int *dirty;
+	int sum;
+	int weighted_sum;
+} StateHash;
+
+// All blocks start out dirty.
+int state_hash_create(StateHash *hash, int size);
+
+void state_hash_destroy(StateHash *hash);
+
+void state_hash_mark(StateHash *hash, size_t offset, size_t len);
+
+void state_hash_mark_all(StateHash *hash);
+
+// Rehashes the dirty blocks of data, which must be size bytes.
+int state_hash_value(StateHash *hash, void const *data);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ifndef _STATE_HASH_H_
@@ -0,0 +1,44 @@
+#ifdef _WIN32
+#include <windows.h>
+#else
+#define _POSIX_C_SOURCE 200809L
+#include <time.h>
+#endif
+#include "timer.h"
+
+#ifdef _WIN32
+
+long long timer_ticks(void)
+{
+	LARGE_INTEGER now;
+	QueryPerformanceCounter(&now);
+	return now.QuadPart;
+}
+
+long long timer_ticks_per_second(void)
+{
+	LARGE_INTEGER frequency;
+	QueryPerformanceFrequency(&frequency);
+	return frequency.QuadPart;
+}
+
+#else
+
+long long timer_ticks(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+long long timer_ticks_per_second(void)
+{
+	return 1000000000LL;
+}
+
+#endif // ifdef _WIN32
+
+double timer_ticks_to_ns(long long ticks)
+{
+	return ticks * 1e9 / timer_ticks_per_second();
+}
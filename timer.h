@@ -0,0 +1,20 @@
+#ifndef _TIMER_H_
+#define _TIMER_H_
+
+// A monotonic, high resolution clock, independent of SDL.
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+long long timer_ticks(void);
+
+long long timer_ticks_per_second(void);
+
+double timer_ticks_to_ns(long long ticks);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ifndef _TIMER_H_
@@ -0,0 +1,24 @@
+#include "timesync.h"
+
+void timesync_request(TimeSync *timesync, int frames_ahead, double frame_ms)
+{
+	timesync->pending_ms = frames_ahead * frame_ms;
+	timesync->applied_ms = 0;
+	timesync->corrections++;
+}
+
+double timesync_stretch(TimeSync *timesync, double frame_ms)
+{
+	double stretch = frame_ms * TIMESYNC_MAX_STRETCH;
+
+	if (stretch > timesync->pending_ms)
+	{
+		stretch = timesync->pending_ms;
+	}
+
+	timesync->pending_ms -= stretch;
+	timesync->applied_ms += stretch;
+	timesync->total_applied_ms += stretch;
+
+	return stretch;
+}
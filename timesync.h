@@ -0,0 +1,35 @@
+#ifndef _TIMESYNC_H_
+#define _TIMESYNC_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// The most a frame is lengthened by to slow down, as a fraction of a frame.
+// An eighth makes up the largest correction GGPO asks for, 9 frames, in 72.
+#define TIMESYNC_MAX_STRETCH 0.125
+
+// Makes up for being ahead of the peers by lengthening frames a little at a
+// time, rather than stalling for the whole correction at once.
+typedef struct TimeSync
+{
+	// Of the correction in progress, what is left and what was applied.
+	double pending_ms;
+	double applied_ms;
+	// Over the whole session.
+	double total_applied_ms;
+	long long corrections;
+} TimeSync;
+
+// The peers are frames_ahead frames behind. Replaces whatever is left of the
+// previous correction, as being behind less by now is already measured.
+void timesync_request(TimeSync *timesync, int frames_ahead, double frame_ms);
+
+// How much longer than frame_ms to make the next frame.
+double timesync_stretch(TimeSync *timesync, double frame_ms);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ifndef _TIMESYNC_H_
@@ -0,0 +1,71 @@
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "triple_buffer.h"
+
+#define TRIPLE_BUFFER_FRESH 4
+
+int triple_buffer_create(TripleBuffer *buffer, size_t size)
+{
+	memset(buffer, 0, sizeof(*buffer));
+
+	for (int i = 0; i < 3; i++)
+	{
+		buffer->buffers[i] = (unsigned char*)calloc(1, size);
+
+		if (!buffer->buffers[i])
+		{
+			triple_buffer_destroy(buffer);
+			return false;
+		}
+	}
+
+	buffer->size = size;
+	buffer->back = 0;
+	buffer->front = 1;
+	SDL_AtomicSet(&buffer->middle, 2);
+
+	return true;
+}
+
+void triple_buffer_destroy(TripleBuffer *buffer)
+{
+	for (int i = 0; i < 3; i++)
+	{
+		free(buffer->buffers[i]);
+	}
+
+	memset(buffer, 0, sizeof(*buffer));
+}
+
+unsigned char *triple_buffer_back(TripleBuffer *buffer)
+{
+	return buffer->buffers[buffer->back];
+}
+
+void triple_buffer_publish(TripleBuffer *buffer)
+{
+	// The frame must be written before the reader can get the buffer.
+	SDL_MemoryBarrierRelease();
+
+	int middle = SDL_AtomicSet(
+		&buffer->middle, buffer->back | TRIPLE_BUFFER_FRESH);
+
+	buffer->back = middle & ~TRIPLE_BUFFER_FRESH;
+	buffer->published++;
+}
+
+unsigned char const *triple_buffer_front(TripleBuffer *buffer)
+{
+	if (SDL_AtomicGet(&buffer->middle) & TRIPLE_BUFFER_FRESH)
+	{
+		int middle = SDL_AtomicSet(&buffer->middle, buffer->front);
+
+		SDL_MemoryBarrierAcquire();
+
+		buffer->front = middle & ~TRIPLE_BUFFER_FRESH;
+		buffer->taken++;
+	}
+
+	return buffer->buffers[buffer->front];
+}
@@ -0,0 +1,48 @@
+#ifndef _TRIPLE_BUFFER_H_
+#define _TRIPLE_BUFFER_H_
+
+#include <stddef.h>
+#include <SDL_atomic.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Hands the latest of a stream of equally sized frames from one thread to
+// another without either ever waiting on the other. The writer fills one
+// buffer while the reader holds another, and the third, in between, holds
+// the last frame published. Publishing and taking each swap a buffer with
+// the one in between, in a single atomic exchange.
+typedef struct TripleBuffer
+{
+	unsigned char *buffers[3];
+	size_t size;
+	// The buffer in between, plus TRIPLE_BUFFER_FRESH while it holds a frame
+	// the reader hasn't taken yet.
+	SDL_atomic_t middle;
+	int back;
+	int front;
+	// Frames published, and those taken by the reader. Only the writer and
+	// the reader, respectively, touch these.
+	long long published;
+	long long taken;
+} TripleBuffer;
+
+int triple_buffer_create(TripleBuffer *buffer, size_t size);
+
+void triple_buffer_destroy(TripleBuffer *buffer);
+
+// The writer's buffer, to fill with the next frame.
+unsigned char *triple_buffer_back(TripleBuffer *buffer);
+
+void triple_buffer_publish(TripleBuffer *buffer);
+
+// The last frame published, or the one the reader had if there is no new
+// one. It stays the reader's until the next call.
+unsigned char const *triple_buffer_front(TripleBuffer *buffer);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ifndef _TRIPLE_BUFFER_H_
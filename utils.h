@@ -5,4 +5,18 @@
 
 #define min(a, b) (((a) < (b)) ? (a) : (b))
 
+// So that the simulation and the renderer, which have no other ties to
+// Windows, build elsewhere.
+#ifndef _MSC_VER
+#include <stdio.h>
+
+#define sprintf_s(buffer, size, ...) snprintf(buffer, size, __VA_ARGS__)
+
+static inline int fopen_s(FILE **fp, char const *filename, char const *mode)
+{
+	*fp = fopen(filename, mode);
+	return *fp ? 0 : 1;
+}
+#endif
+
 #endif // ifndef _UTILS_H
@@ -0,0 +1,197 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench_input.h"
+#include "bullets.h"
+#include "game.h"
+#include "game_state.h"
+#include "timer.h"
+
+// Runs the simulation headless, without SDL or GGPO, and reports how fast it
+// steps. Inputs are either scripted or drawn from a seeded generator, so that
+// the final hash is the same run after run for the same arguments.
+
+#define ARENA_WIDTH  640
+#define ARENA_HEIGHT 480
+
+enum INPUT_SOURCE
+{
+	INPUT_SOURCE_random,
+	INPUT_SOURCE_scripted,
+};
+
+typedef struct BenchOptions
+{
+	long long frames;
+	int num_ships;
+	int max_bullets;
+	unsigned int seed;
+	enum INPUT_SOURCE source;
+	enum BULLET_KERNEL kernel;
+} BenchOptions;
+
+// xorshift32, good enough to keep every ship busy.
+static unsigned int next_random(unsigned int *state)
+{
+	unsigned int x = *state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	return *state = x;
+}
+
+static void show_syntax()
+{
+	fprintf(stderr,
+		"Syntax: vectorwar_bench [--frames n] [--ships n] [--bullets n]\n"
+		"                        [--seed n] [--scripted]\n"
+		"                        [--kernel best|scalar|sse2|avx2]\n");
+}
+
+static int parse_kernel(char const *name, enum BULLET_KERNEL *kernel)
+{
+	static const struct
+	{
+		char const *name;
+		enum BULLET_KERNEL kernel;
+	} kernels[] =
+	{
+		{ "best", BULLET_KERNEL_best },
+		{ "scalar", BULLET_KERNEL_scalar },
+		{ "sse2", BULLET_KERNEL_sse2 },
+		{ "avx2", BULLET_KERNEL_avx2 },
+	};
+
+	for (size_t i = 0; i < sizeof kernels / sizeof kernels[0]; i++)
+	{
+		if (!strcmp(name, kernels[i].name))
+		{
+			*kernel = kernels[i].kernel;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static int parse_args(int argc, char *args[], BenchOptions *options)
+{
+	options->frames = 10000000;
+	options->num_ships = 4;
+	options->max_bullets = DEFAULT_MAX_BULLETS;
+	options->seed = 1;
+	options->source = INPUT_SOURCE_random;
+	options->kernel = BULLET_KERNEL_best;
+
+	for (int i = 1; i < argc; i++)
+	{
+		char const *value = i + 1 < argc ? args[i + 1] : NULL;
+
+		if (!strcmp(args[i], "--scripted"))
+		{
+			options->source = INPUT_SOURCE_scripted;
+			continue;
+		}
+
+		if (!value)
+		{
+			return false;
+		}
+
+		if (!strcmp(args[i], "--frames"))
+		{
+			options->frames = atoll(value);
+		}
+		else if (!strcmp(args[i], "--ships"))
+		{
+			options->num_ships = atoi(value);
+		}
+		else if (!strcmp(args[i], "--bullets"))
+		{
+			options->max_bullets = atoi(value);
+		}
+		else if (!strcmp(args[i], "--seed"))
+		{
+			options->seed = (unsigned int)strtoul(value, NULL, 10);
+		}
+		else if (!strcmp(args[i], "--kernel"))
+		{
+			if (!parse_kernel(value, &options->kernel))
+			{
+				return false;
+			}
+		}
+		else
+		{
+			return false;
+		}
+
+		i++;
+	}
+
+	return options->frames > 0 &&
+		options->num_ships > 0 &&
+		options->max_bullets > 0 &&
+		options->seed != 0;
+}
+
+int main(int argc, char *args[])
+{
+	BenchOptions options;
+
+	if (!parse_args(argc, args, &options))
+	{
+		show_syntax();
+		return 1;
+	}
+
+	LocalInput *inputs =
+		(LocalInput*)calloc(options.num_ships, sizeof(LocalInput));
+
+	if (!inputs || !setup_game(
+		ARENA_WIDTH, ARENA_HEIGHT, options.num_ships, options.max_bullets))
+	{
+		fprintf(stderr, "Out of memory.\n");
+		return 1;
+	}
+
+	game_set_bullet_kernel(options.kernel);
+
+	unsigned int random = options.seed;
+	long long start = timer_ticks();
+
+	for (long long frame = 0; frame < options.frames; frame++)
+	{
+		for (int i = 0; i < options.num_ships; i++)
+		{
+			inputs[i].inputs = options.source == INPUT_SOURCE_random
+				? (int)(next_random(&random) & 0x3f)
+				: scripted_input(frame, i);
+		}
+
+		step_game(inputs, 0);
+	}
+
+	double elapsed = timer_ticks_to_ns(timer_ticks() - start) / 1e9;
+
+#ifdef VECTORWAR_FIXED_POINT
+	char const *scalar = "fixed";
+#else
+	char const *scalar = "double";
+#endif
+
+	printf("ships:      %d x %d bullets\n",
+		options.num_ships, options.max_bullets);
+	printf("state:      %d bytes, %s\n", game_state()->size, scalar);
+	printf("frames:     %lld\n", options.frames);
+	printf("seconds:    %.3f\n", elapsed);
+	printf("frames/sec: %.0f\n", options.frames / elapsed);
+	printf("ns/frame:   %.1f\n", elapsed * 1e9 / options.frames);
+	printf("hash:       %08x\n", game_state_hash());
+
+	tear_down_game();
+	free(inputs);
+
+	return 0;
+}